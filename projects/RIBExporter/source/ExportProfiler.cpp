@@ -0,0 +1,251 @@
+﻿/**
+ * エクスポート処理の計測.
+ */
+
+#include "ExportProfiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+namespace {
+	/**
+	 * JSONの文字列として出力できるようにエスケープ.
+	 */
+	std::string EscapeJSON (const std::string& str) {
+		std::string ret;
+		for (size_t i = 0; i < str.size(); ++i) {
+			const char c = str[i];
+			if (c == '"' || c == '\\') {
+				ret += '\\';
+				ret += c;
+			} else if ((unsigned char)c < 0x20) {
+				char buff[8];
+				sprintf(buff, "\\u%04x", (int)(unsigned char)c);
+				ret += buff;
+			} else {
+				ret += c;
+			}
+		}
+		return ret;
+	}
+
+	/**
+	 * 同じ処理/形状の合計.
+	 */
+	class CEventTotal
+	{
+	public:
+		std::string name;
+		long long duration;
+		int count;
+		CExportProfiler::CCounters counters;
+
+	public:
+		CEventTotal () {
+			duration = 0;
+			count    = 0;
+		}
+	};
+
+	bool CompareDuration (const CEventTotal& a, const CEventTotal& b) {
+		return a.duration > b.duration;
+	}
+
+	/**
+	 * マイクロ秒をミリ秒のテキストに変換.
+	 */
+	std::string FormatMS (const long long us) {
+		char buff[32];
+		sprintf(buff, "%.1f ms", (double)us / 1000.0);
+		return buff;
+	}
+}
+
+//-----------------------------------------------------------.
+
+CExportProfiler::CScope::CScope (CExportProfiler* profiler, const std::string& name, const char* category, const int shapeID) : m_profiler(profiler), m_category(category), m_shapeID(shapeID)
+{
+	m_startTime   = 0;
+	m_hasCounters = false;
+	if (!m_profiler) return;
+
+	m_name      = name;
+	m_startTime = m_profiler->GetTime();
+}
+
+CExportProfiler::CScope::~CScope ()
+{
+	if (!m_profiler) return;
+	m_profiler->AddEvent(m_name, m_category, m_startTime, m_profiler->GetTime() - m_startTime, m_hasCounters ? &m_counters : NULL, m_shapeID);
+}
+
+/**
+ * 記録するカウンタを指定.
+ */
+void CExportProfiler::CScope::SetCounters (const CCounters& counters)
+{
+	m_counters    = counters;
+	m_hasCounters = true;
+}
+
+//-----------------------------------------------------------.
+
+CExportProfiler::CExportProfiler ()
+{
+	Clear();
+}
+
+/**
+ * 計測を開始 (記録をクリア).
+ */
+void CExportProfiler::Clear ()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_startTime = std::chrono::steady_clock::now();
+	m_events.clear();
+	m_threadIndices.clear();
+	m_threadIndices[std::this_thread::get_id()] = 0;
+}
+
+/**
+ * 計測開始からの時間をマイクロ秒で取得.
+ */
+long long CExportProfiler::GetTime () const
+{
+	return (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+/**
+ * カレントスレッドの番号を取得 (m_mutexをロックした状態で呼ぶこと).
+ */
+int CExportProfiler::m_GetThreadIndex ()
+{
+	const std::thread::id id = std::this_thread::get_id();
+	std::map<std::thread::id, int>::const_iterator iter = m_threadIndices.find(id);
+	if (iter != m_threadIndices.end()) return iter->second;
+
+	const int index = (int)m_threadIndices.size();
+	m_threadIndices[id] = index;
+	return index;
+}
+
+/**
+ * 処理を記録.
+ */
+void CExportProfiler::AddEvent (const std::string& name, const char* category, const long long startTime, const long long duration, const CCounters* counters, const int shapeID)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_events.push_back(CEvent());
+	CEvent& event = m_events.back();
+	event.name        = name;
+	event.category    = category;
+	event.shapeID     = shapeID;
+	event.threadIndex = m_GetThreadIndex();
+	event.startTime   = startTime;
+	event.duration    = duration;
+	if (counters) {
+		event.hasCounters = true;
+		event.counters    = *counters;
+	}
+}
+
+/**
+ * 集計結果をテキストで取得.
+ * 処理段階(phase)は記録順、形状は通し番号ごとに合計して処理時間の長い順に出力する.
+ * 形状名は表示にのみ使用する (同じ名前の形状は別々に集計する).
+ */
+void CExportProfiler::GetSummary (std::vector<std::string>& lines, const int maxShapes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	lines.clear();
+
+	std::vector<CEventTotal> phases;
+	std::map<int, CEventTotal> shapes;
+	CEventTotal storeTotal, shapeTotal, meshTotal;
+	for (size_t i = 0; i < m_events.size(); ++i) {
+		const CEvent& event = m_events[i];
+		if (event.category == "phase") {
+			phases.push_back(CEventTotal());
+			phases.back().name     = event.name;
+			phases.back().duration = event.duration;
+			continue;
+		}
+
+		CEventTotal* total = NULL;
+		if (event.category == "store") total = &storeTotal;
+		else if (event.category == "shape") total = &shapeTotal;
+		else if (event.category == "mesh") total = &meshTotal;
+		if (!total) continue;
+		total->duration += event.duration;
+		total->count++;
+
+		// 形状ごとの時間は、メインスレッドでの格納/出力と、頂点の分離/変換処理の合計.
+		if (event.shapeID < 0) continue;
+		CEventTotal& shape = shapes[event.shapeID];
+		shape.name      = event.name;
+		shape.duration += event.duration;
+		if (event.hasCounters) {
+			meshTotal.counters.faces          += event.counters.faces;
+			meshTotal.counters.outputVertices += event.counters.outputVertices;
+			meshTotal.counters.bytes          += event.counters.bytes;
+			shape.counters.faces          += event.counters.faces;
+			shape.counters.outputVertices += event.counters.outputVertices;
+			shape.counters.bytes          += event.counters.bytes;
+			shape.counters.inputVertices   = std::max(shape.counters.inputVertices, event.counters.inputVertices);
+		}
+	}
+
+	lines.push_back("[ export profile ]");
+	for (size_t i = 0; i < phases.size(); ++i) {
+		lines.push_back("  " + phases[i].name + " : " + FormatMS(phases[i].duration));
+	}
+
+	// 入力の頂点数はfaceGroupごとの出力で同じ値が記録されるため、形状ごとに1回だけ数える.
+	std::vector<CEventTotal> shapeList;
+	for (std::map<int, CEventTotal>::const_iterator iter = shapes.begin(); iter != shapes.end(); ++iter) {
+		shapeList.push_back(iter->second);
+		meshTotal.counters.inputVertices += iter->second.counters.inputVertices;
+	}
+
+	char buff[256];
+	sprintf(buff, "  shapes : %d  face groups : %d  faces : %d  input vertices : %d  output vertices : %d  bytes : %llu",
+		(int)shapeList.size(), meshTotal.count, meshTotal.counters.faces, meshTotal.counters.inputVertices, meshTotal.counters.outputVertices, (unsigned long long)meshTotal.counters.bytes);
+	lines.push_back(buff);
+	lines.push_back("  store (main thread) : " + FormatMS(storeTotal.duration) + "  write (main thread) : " + FormatMS(shapeTotal.duration) + "  convert (all threads) : " + FormatMS(meshTotal.duration));
+
+	std::sort(shapeList.begin(), shapeList.end(), CompareDuration);
+	const int cou = std::min((int)shapeList.size(), maxShapes);
+	if (cou > 0) lines.push_back("  slowest shapes :");
+	for (int i = 0; i < cou; ++i) {
+		const CEventTotal& shape = shapeList[i];
+		sprintf(buff, "  faces : %d  vertices : %d -> %d  bytes : %llu", shape.counters.faces, shape.counters.inputVertices, shape.counters.outputVertices, (unsigned long long)shape.counters.bytes);
+		lines.push_back("    " + shape.name + " : " + FormatMS(shape.duration) + buff);
+	}
+}
+
+/**
+ * Chromeのトレース形式(JSON)で保存.
+ */
+bool CExportProfiler::SaveTrace (const std::string& filePath)
+{
+	FILE* fp = fopen(filePath.c_str(), "wb");
+	if (!fp) return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < m_events.size(); ++i) {
+		const CEvent& event = m_events[i];
+		fprintf(fp, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld",
+			EscapeJSON(event.name).c_str(), event.category.c_str(), event.threadIndex, event.startTime, event.duration);
+		if (event.hasCounters) {
+			fprintf(fp, ",\"args\":{\"shape\":%d,\"faces\":%d,\"inputVertices\":%d,\"outputVertices\":%d,\"bytes\":%llu}",
+				event.shapeID, event.counters.faces, event.counters.inputVertices, event.counters.outputVertices, (unsigned long long)event.counters.bytes);
+		} else if (event.shapeID >= 0) {
+			fprintf(fp, ",\"args\":{\"shape\":%d}", event.shapeID);
+		}
+		fprintf(fp, "}%s\n", (i + 1 < m_events.size()) ? "," : "");
+	}
+	fprintf(fp, "],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(fp);
+	return true;
+}
@@ -0,0 +1,135 @@
+﻿/**
+ * エクスポート処理の計測.
+ * 処理段階ごと/形状ごとの処理時間と、面数や出力バイト数などを記録し、
+ * 集計結果の表示と、Chromeのトレース形式(JSON)での保存を行う.
+ */
+
+#ifndef _EXPORTPROFILER_H
+#define _EXPORTPROFILER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+class CExportProfiler
+{
+public:
+	/**
+	 * 形状ごとのカウンタ.
+	 */
+	class CCounters
+	{
+	public:
+		int faces;						// 面数.
+		int inputVertices;				// 入力の頂点数.
+		int outputVertices;				// 法線/UVで分離後の頂点数.
+		size_t bytes;					// 出力したバイト数 (圧縮前).
+
+	public:
+		CCounters () {
+			faces          = 0;
+			inputVertices  = 0;
+			outputVertices = 0;
+			bytes          = 0;
+		}
+	};
+
+	/**
+	 * 計測した処理.
+	 */
+	class CEvent
+	{
+	public:
+		std::string name;				// 処理名もしくは形状名.
+		std::string category;			// 種類 (phase/store/shape/mesh).
+		int shapeID;					// 形状の通し番号 (形状に属さない処理は-1).
+		int threadIndex;				// スレッド番号 (0がメインスレッド).
+		long long startTime;			// 開始時間 (計測開始からのマイクロ秒).
+		long long duration;				// 処理時間 (マイクロ秒).
+		bool hasCounters;				// countersを使用する場合はtrue.
+		CCounters counters;
+
+	public:
+		CEvent () {
+			shapeID     = -1;
+			threadIndex = 0;
+			startTime   = 0;
+			duration    = 0;
+			hasCounters = false;
+		}
+	};
+
+	/**
+	 * スコープの開始から終了までを計測.
+	 * profilerがNULLの場合は何もしない.
+	 */
+	class CScope
+	{
+	private:
+		CExportProfiler* m_profiler;
+		std::string m_name;
+		const char* m_category;
+		int m_shapeID;
+		long long m_startTime;
+		bool m_hasCounters;
+		CCounters m_counters;
+
+	public:
+		CScope (CExportProfiler* profiler, const std::string& name, const char* category, const int shapeID = -1);
+		~CScope ();
+
+		/**
+		 * 記録するカウンタを指定.
+		 */
+		void SetCounters (const CCounters& counters);
+	};
+
+private:
+	std::chrono::steady_clock::time_point m_startTime;		// 計測開始時間.
+	std::vector<CEvent> m_events;							// 計測した処理.
+	std::map<std::thread::id, int> m_threadIndices;			// スレッドごとの番号.
+	std::mutex m_mutex;
+
+	/**
+	 * カレントスレッドの番号を取得.
+	 */
+	int m_GetThreadIndex ();
+
+public:
+	CExportProfiler ();
+
+	/**
+	 * 計測を開始 (記録をクリア).
+	 * 呼び出したスレッドをメインスレッドとする.
+	 */
+	void Clear ();
+
+	/**
+	 * 計測開始からの時間をマイクロ秒で取得.
+	 */
+	long long GetTime () const;
+
+	/**
+	 * 処理を記録.
+	 * 複数のスレッドから同時に呼び出せる.
+	 * @param[in] shapeID  形状ごとに集計する場合の形状の通し番号 (形状に属さない処理は-1).
+	 */
+	void AddEvent (const std::string& name, const char* category, const long long startTime, const long long duration, const CCounters* counters = NULL, const int shapeID = -1);
+
+	/**
+	 * 集計結果をテキストで取得.
+	 * @param[in] maxShapes  処理時間の長い順に表示する形状の数.
+	 */
+	void GetSummary (std::vector<std::string>& lines, const int maxShapes = 10);
+
+	/**
+	 * Chromeのトレース形式(JSON)で保存 (chrome://tracing で表示できる).
+	 * @return ファイルを作成できなかった場合はfalse.
+	 */
+	bool SaveTrace (const std::string& filePath);
+};
+
+#endif
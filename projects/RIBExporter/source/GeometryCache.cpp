@@ -0,0 +1,155 @@
+﻿/**
+ * 形状アーカイブのキャッシュ情報.
+ */
+
+#include "GeometryCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace {
+	inline unsigned long long RotateLeft (const unsigned long long v, const int r) {
+		return (v << r) | (v >> (64 - r));
+	}
+}
+
+//-----------------------------------------------------------.
+
+CHashCalc::CHashCalc ()
+{
+	m_hash   = 0x9e3779b97f4a7c15ULL;
+	m_length = 0;
+}
+
+/**
+ * 8バイト単位でハッシュ値に加える.
+ */
+void CHashCalc::m_Mix (unsigned long long k)
+{
+	k *= 0x87c37b91114253d5ULL;
+	k  = RotateLeft(k, 31);
+	k *= 0x4cf5ad432745937fULL;
+	m_hash ^= k;
+	m_hash  = RotateLeft(m_hash, 27) * 5 + 0x52dce729;
+}
+
+/**
+ * データを追加.
+ */
+void CHashCalc::Append (const void* data, const size_t size)
+{
+	const unsigned char* p = (const unsigned char *)data;
+	size_t rSize = size;
+	unsigned long long k;
+	while (rSize >= 8) {
+		memcpy(&k, p, 8);
+		m_Mix(k);
+		p     += 8;
+		rSize -= 8;
+	}
+	if (rSize > 0) {
+		k = 0;
+		memcpy(&k, p, rSize);
+		m_Mix(k);
+	}
+	m_length += size;
+}
+
+/**
+ * ハッシュ値を取得.
+ */
+unsigned long long CHashCalc::GetHash () const
+{
+	unsigned long long h = m_hash ^ m_length;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+//-----------------------------------------------------------.
+
+CGeometryArchiveCache::CGeometryArchiveCache ()
+{
+	m_writtenCount = 0;
+	m_reusedCount  = 0;
+}
+
+/**
+ * キャッシュ情報を読み込み.
+ * 1行ごとに「ハッシュ値(16進数) アーカイブファイル名」が格納されている.
+ */
+void CGeometryArchiveCache::Load (const std::string& archivePath, const std::string& filePath)
+{
+	m_archivePath = archivePath;
+	m_filePath    = filePath;
+	m_prevHashes.clear();
+	m_hashes.clear();
+	m_writtenCount = 0;
+	m_reusedCount  = 0;
+
+	FILE* fp = fopen(filePath.c_str(), "rb");
+	if (!fp) return;
+
+	char szLine[1024];
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		char* pPos = strchr(szLine, ' ');
+		if (!pPos) continue;
+		*pPos = '\0';
+
+		std::string name(pPos + 1);
+		while (!name.empty() && (name[name.length() - 1] == '\n' || name[name.length() - 1] == '\r')) {
+			name = name.substr(0, name.length() - 1);
+		}
+		if (name.empty()) continue;
+
+		unsigned long long hash = 0;
+		if (sscanf(szLine, "%llx", &hash) != 1) continue;
+		m_prevHashes[name] = hash;
+	}
+	fclose(fp);
+}
+
+/**
+ * 今回のエクスポートでのキャッシュ情報を保存.
+ */
+void CGeometryArchiveCache::Save ()
+{
+	if (m_filePath.empty()) return;
+
+	FILE* fp = fopen(m_filePath.c_str(), "wb");
+	if (!fp) return;
+
+	std::map<std::string, unsigned long long>::const_iterator it;
+	for (it = m_hashes.begin(); it != m_hashes.end(); ++it) {
+		fprintf(fp, "%016llx %s\n", it->second, it->first.c_str());
+	}
+	fclose(fp);
+}
+
+/**
+ * 前回出力したアーカイブファイルをそのまま使用できるか.
+ * ハッシュ値が一致し、ファイルが存在する場合に使用できる.
+ */
+bool CGeometryArchiveCache::IsValid (const std::string& fileName, const unsigned long long hash) const
+{
+	std::map<std::string, unsigned long long>::const_iterator it = m_prevHashes.find(fileName);
+	if (it == m_prevHashes.end() || it->second != hash) return false;
+
+	struct stat buffer;
+	return (stat((m_archivePath + "/" + fileName).c_str(), &buffer) == 0);
+}
+
+/**
+ * アーカイブファイルのハッシュ値を登録.
+ */
+void CGeometryArchiveCache::Set (const std::string& fileName, const unsigned long long hash, const bool reused)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_hashes[fileName] = hash;
+	if (reused) m_reusedCount++;
+	else m_writtenCount++;
+}
@@ -0,0 +1,98 @@
+﻿/**
+ * 形状アーカイブのキャッシュ情報.
+ * 前回のエクスポートで出力したアーカイブファイルと、その内容のハッシュ値を保持し、
+ * 内容が変わっていない形状はファイルを再出力せずにそのまま使用する.
+ */
+
+#ifndef _GEOMETRYCACHE_H
+#define _GEOMETRYCACHE_H
+
+#include "GlobalHeader.h"
+
+#include <map>
+#include <mutex>
+
+/**
+ * 64bitのハッシュ値の計算クラス.
+ */
+class CHashCalc
+{
+private:
+	unsigned long long m_hash;
+	unsigned long long m_length;
+
+	/**
+	 * 8バイト単位でハッシュ値に加える.
+	 */
+	void m_Mix (unsigned long long k);
+
+public:
+	CHashCalc ();
+
+	/**
+	 * データを追加.
+	 */
+	void Append (const void* data, const size_t size);
+	void Append (const int value) { Append(&value, sizeof(int)); }
+
+	template<class T> void Append (const std::vector<T>& values) {
+		Append((int)values.size());
+		if (!values.empty()) Append(&(values[0]), sizeof(T) * values.size());
+	}
+
+	/**
+	 * ハッシュ値を取得.
+	 */
+	unsigned long long GetHash () const;
+};
+
+/**
+ * 形状アーカイブのキャッシュ情報.
+ */
+class CGeometryArchiveCache
+{
+private:
+	std::string m_filePath;											// キャッシュ情報のファイルパス.
+	std::string m_archivePath;										// アーカイブファイルの基準となるパス.
+	std::map<std::string, unsigned long long> m_prevHashes;			// 前回のエクスポートでのアーカイブ名とハッシュ値.
+	std::map<std::string, unsigned long long> m_hashes;				// 今回のエクスポートでのアーカイブ名とハッシュ値.
+
+	int m_writtenCount;												// 出力したアーカイブ数.
+	int m_reusedCount;												// 再利用したアーカイブ数.
+
+	std::mutex m_mutex;												// 複数スレッドからの登録用.
+
+public:
+	CGeometryArchiveCache ();
+
+	/**
+	 * キャッシュ情報を読み込み.
+	 * @param[in] archivePath  アーカイブファイルの基準となるパス (RIBファイルの保存パス).
+	 * @param[in] filePath     キャッシュ情報のファイルパス.
+	 */
+	void Load (const std::string& archivePath, const std::string& filePath);
+
+	/**
+	 * 今回のエクスポートでのキャッシュ情報を保存.
+	 */
+	void Save ();
+
+	/**
+	 * 前回出力したアーカイブファイルをそのまま使用できるか.
+	 * @param[in] fileName  アーカイブファイル名 (geometry/xxx.rib).
+	 * @param[in] hash      アーカイブの内容のハッシュ値.
+	 */
+	bool IsValid (const std::string& fileName, const unsigned long long hash) const;
+
+	/**
+	 * アーカイブファイルのハッシュ値を登録.
+	 * 異なるスレッドから同時に呼び出せる.
+	 * @param[in] reused  前回のアーカイブファイルを再利用した場合はtrue.
+	 */
+	void Set (const std::string& fileName, const unsigned long long hash, const bool reused);
+
+	int GetWrittenCount () const { return m_writtenCount; }
+	int GetReusedCount () const { return m_reusedCount; }
+};
+
+#endif
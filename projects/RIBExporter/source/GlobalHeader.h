@@ -26,8 +26,23 @@
 #define RIB_EXPORT_DLG_VERSION_101		0x101		// ver.1.0.0.1 - .
 #define RIB_EXPORT_DLG_VERSION_104		0x104		// ver.1.0.0.4 - .
 #define RIB_EXPORT_DLG_VERSION_105		0x105		// ver.1.0.0.5 - .
-#define RIB_EXPORT_DLG_VERSION_1105		0x1105		// current (ver.1.1.0.5 - ).
-#define RIB_EXPORT_DLG_VERSION			0x1105		// current (ver.1.1.0.5 - ).
+#define RIB_EXPORT_DLG_VERSION_1105		0x1105		// ver.1.1.0.5 - .
+#define RIB_EXPORT_DLG_VERSION_1106		0x1106		// ver.1.1.0.6 - .
+#define RIB_EXPORT_DLG_VERSION_1107		0x1107		// ver.1.1.0.7 - .
+#define RIB_EXPORT_DLG_VERSION_1108		0x1108		// ver.1.1.0.8 - .
+#define RIB_EXPORT_DLG_VERSION_1109		0x1109		// ver.1.1.0.9 - .
+#define RIB_EXPORT_DLG_VERSION_1110		0x1110		// ver.1.1.1.0 - .
+#define RIB_EXPORT_DLG_VERSION_1111		0x1111		// ver.1.1.1.1 - .
+#define RIB_EXPORT_DLG_VERSION_1112		0x1112		// ver.1.1.1.2 - .
+#define RIB_EXPORT_DLG_VERSION_1113		0x1113		// ver.1.1.1.3 - .
+#define RIB_EXPORT_DLG_VERSION_1114		0x1114		// ver.1.1.1.4 - .
+#define RIB_EXPORT_DLG_VERSION_1115		0x1115		// ver.1.1.1.5 - .
+#define RIB_EXPORT_DLG_VERSION_1116		0x1116		// ver.1.1.1.6 - .
+#define RIB_EXPORT_DLG_VERSION_1117		0x1117		// ver.1.1.1.7 - .
+#define RIB_EXPORT_DLG_VERSION_1118		0x1118		// ver.1.1.1.8 - .
+#define RIB_EXPORT_DLG_VERSION_1119		0x1119		// ver.1.1.1.9 - .
+#define RIB_EXPORT_DLG_VERSION_111a		0x111a		// current (ver.1.1.1.a - ).
+#define RIB_EXPORT_DLG_VERSION			0x111a		// current (ver.1.1.1.a - ).
 
 #define RIB_MATERIAL_VERSION_100		0x100		// Materialのバージョン.
 #define RIB_MATERIAL_VERSION_102		0x102		// ver.1.0.0.2 - 
@@ -35,6 +50,11 @@
 
 #define RIB_AREA_LIGHT_VERSION			0x100		// 面光源情報のバージョン.
 
+#define MESH_WELD_TOLERANCE				1e-5f		// 頂点を法線/UVで分ける際に、同一とみなす許容値の初期値.
+#define RIB_MAX_VERTICES_PER_FACE		65536		// 5角形以上の面を分割しない場合に受け付ける、面の頂点数の最大.
+#define MESH_POOL_MAX_COUNT				8			// 再利用のために保持するポリゴンメッシュ情報/作業領域の最大数.
+#define MESH_POOL_MAX_BYTES				(32 * 1024 * 1024)	// 再利用のために保持する場合の、1つあたりの確保済み領域の上限 (超える場合は解放する).
+
 
 namespace RIBParam
 {
@@ -88,6 +108,14 @@ namespace RIBParam
 		size_4096x2048,
 		size_8192x4096,
 	};
+
+	/**
+	 * RIBファイルの出力形式.
+	 */
+	enum RIB_ENCODING_TYPE {
+		rib_ascii = 0,				// ASCII.
+		rib_binary,					// RenderManのBinary encoding.
+	};
 }
 
 /**
@@ -125,6 +153,29 @@ public:
 
 	bool doDenoise;												// Denoise処理を有効にする場合はtrue.
 
+	RIBParam::RIB_ENCODING_TYPE ribEncoding;					// RIBファイルの出力形式.
+	bool ribCompress;											// RIBファイルをgzip圧縮(.rib.gz)して出力する場合はtrue.
+	bool geometryArchive;										// 形状ごとにgeometryフォルダ内のアーカイブファイルに分けて出力する場合はtrue.
+	bool geometryCache;											// 内容が変わっていない形状アーカイブは、前回出力したファイルを再利用する場合はtrue.
+	bool parallelOutput;										// 形状の出力処理を複数スレッドで行う場合はtrue.
+	bool objectInstance;										// リンクされた形状を、ObjectBegin/ObjectInstanceでインスタンスとして出力する場合はtrue.
+	int precisionP;												// 頂点座標(P)の有効桁数 (0の場合は元の値に戻る最短の桁数).
+	int precisionN;												// 法線(N)の小数点以下の桁数 (0の場合は元の値に戻る最短の桁数).
+	int precisionST;											// UV(st)の小数点以下の桁数 (0の場合は元の値に戻る最短の桁数).
+	float quantizeGrid;											// 頂点座標(P)を量子化する間隔 (0の場合は量子化しない).
+	bool streamingOutput;										// 形状をメモリ上に保持せず、分割して直接出力する場合はtrue (大きなメッシュ用).
+	bool profileExport;											// エクスポート処理の時間と形状ごとの情報を計測して表示する場合はtrue.
+	bool profileTrace;											// 計測結果をChromeのトレース形式(JSON)でRIBファイルと同じ場所に保存する場合はtrue.
+	float weldTolerance;										// 頂点を法線/UVで分ける際に、同一とみなす許容値 (0の場合は完全一致のみ).
+	bool facevaryingPrimvars;									// 頂点を分けずに、法線/UVを面の頂点ごとの値(facevarying)として出力する場合はtrue.
+	bool lodDecimation;											// 画面上で小さく表示される形状を簡略化して出力する場合はtrue.
+	float lodPixelSize;											// 簡略化後の辺の長さの目安 (ピクセル数).
+	bool ngonPassthrough;										// 5角形以上の面を分割せずに出力する場合はtrue.
+	bool localSpaceGeometry;									// 形状の頂点をローカル座標で出力し、ConcatTransformで配置する場合はtrue.
+	bool frustumCulling;										// カメラの視野外の形状を出力しない場合はtrue.
+	float cullMargin;											// 視野外判定で視野を広げる余白 (%).
+	float cullKeepRadius;										// カメラからこの距離内の形状は視野外でも出力 (0の場合は無効).
+
 public:
 	RIBExportData () {
 		Clear();
@@ -158,6 +209,29 @@ public:
 		statisticsXMLFile    = false;
 		doSubdivision        = true;
 		doDenoise			 = false;
+
+		ribEncoding          = RIBParam::rib_ascii;
+		ribCompress          = false;
+		geometryArchive      = false;
+		geometryCache        = true;
+		parallelOutput       = true;
+		objectInstance       = true;
+		precisionP           = 0;
+		precisionN           = 4;
+		precisionST          = 5;
+		quantizeGrid         = 0.0f;
+		streamingOutput      = false;
+		profileExport        = false;
+		profileTrace         = false;
+		weldTolerance        = MESH_WELD_TOLERANCE;
+		facevaryingPrimvars  = false;
+		lodDecimation        = false;
+		lodPixelSize         = 2.0f;
+		ngonPassthrough      = false;
+		localSpaceGeometry   = false;
+		frustumCulling       = false;
+		cullMargin           = 10.0f;
+		cullKeepRadius       = 0.0f;
 	}
 };
 
@@ -4,6 +4,26 @@
 
 #include "MathUtil.h"
 
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MATHUTIL_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVXは実行時にCPUが対応している場合のみ使用する (コンパイラオプションでAVXを有効にしない).
+#if defined(MATHUTIL_USE_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define MATHUTIL_USE_AVX
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MATHUTIL_TARGET_AVX
+#else
+#include <cpuid.h>
+#define MATHUTIL_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
 namespace {
 	/**
 	 * 2点のベジェでの制御点が与えられたときの対応点を計算.
@@ -94,79 +114,349 @@ namespace {
 	};
 }
 
-/**
- * ガウスの消去法で逆行列計算.
- */
-bool MathUtil::InverseMatrix (const sxsdk::mat4& m, sxsdk::mat4& retM)
-{
-	sxsdk::mat4 mat;
-	double fDat, fDat2;
-	double mat_8x4[4][8];
-	bool flag;
+namespace {
+	/**
+	 * floatがNaN/Infか (指数部がすべて1).
+	 */
+	inline bool IsInvalidFloat (const float v) {
+		unsigned int bits;
+		memcpy(&bits, &v, sizeof(float));
+		return (bits & 0x7f800000) == 0x7f800000;
+	}
 
-	// 8 x 4行列に値を入れる.
-	for (int i = 0; i < 4; i++) {
-		for (int j = 0; j < 4; j++) mat_8x4[i][j] = (double)(m[i][j]);
-		for (int j = 0; j < 4; j++) {
-			if (i == j)  mat_8x4[i][j + 4] = 1.0;
-			else         mat_8x4[i][j + 4] = 0.0;
+	/**
+	 * float配列にNaN/Infが含まれるか.
+	 */
+	bool HasInvalidFloat (const float* values, const size_t count) {
+		size_t i = 0;
+#ifdef MATHUTIL_USE_SSE2
+		const __m128i expMask = _mm_set1_epi32(0x7f800000);
+		__m128i result = _mm_setzero_si128();
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(values + i)), expMask);
+			result = _mm_or_si128(result, _mm_cmpeq_epi32(v, expMask));
 		}
+		if (_mm_movemask_epi8(result) != 0) return true;
+#endif
+		for (; i < count; ++i) {
+			if (IsInvalidFloat(values[i])) return true;
+		}
+		return false;
 	}
 
-	flag = true;
-	for (int loop = 0; loop < 4; loop++) {
-		fDat = mat_8x4[loop][loop];
-		if (fDat != 1.0) {
-			if (fDat == 0.0) {
-				int i = loop + 1;
-				for (; i < 4; i++) {
-					fDat = mat_8x4[i][loop];
-					if(fDat != 0.0) break;
-				}
-				if (i >= 4) {
-					flag = false;
-					break;
-				}
-
-				// 行を入れ替える.
-				for (int j = 0; j < 8; j++) {
-					fDat = mat_8x4[i][j];
-					mat_8x4[i][j]    = mat_8x4[loop][j];
-					mat_8x4[loop][j] = fDat;
-				}
-				fDat = mat_8x4[loop][loop];
-			}
-			for (int i = 0; i < 8; i++) mat_8x4[loop][i] /= fDat;
+	/**
+	 * 多角形を、Newell法で求めた法線の最も大きい成分の軸を除いた2D座標に投影.
+	 * 桁落ちを避けるため、先頭の頂点からの相対位置とする.
+	 * 投影後の多角形が時計回りになる場合は、反時計回りになるようにX座標の符号を反転する.
+	 * @return 面積がない場合はfalse.
+	 */
+	bool ProjectPolygon2D (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count, std::vector<double>& pos, std::vector<double>& retXY) {
+		const sxsdk::vec3& v0 = vertices[ indices[0] ];
+		pos.resize(count * 3);
+		for (int i = 0; i < count; ++i) {
+			const sxsdk::vec3& v = vertices[ indices[i] ];
+			pos[i * 3 + 0] = (double)v.x - (double)v0.x;
+			pos[i * 3 + 1] = (double)v.y - (double)v0.y;
+			pos[i * 3 + 2] = (double)v.z - (double)v0.z;
 		}
-		for (int i = 0; i < 4; i++) {
-			if (i != loop) {
-				fDat = mat_8x4[i][loop];
-				if (fDat != 0.0f) {
-					//mat[i][loop]をmat[loop]の行にかけて.
-					//(mat[j] - mat[loop] * fDat)を計算.
-					for (int j = 0; j < 8; j++) {
-						fDat2 = mat_8x4[loop][j] * fDat;
-						mat_8x4[i][j] -= fDat2;
-					}
-				}
-			}
+
+		double n[3] = {0.0, 0.0, 0.0};
+		for (int i = 0; i < count; ++i) {
+			const double* a = &pos[i * 3];
+			const double* b = &pos[((i + 1) % count) * 3];
+			n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+			n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+			n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+		}
+		int axis = 0;
+		if (std::abs(n[1]) > std::abs(n[axis])) axis = 1;
+		if (std::abs(n[2]) > std::abs(n[axis])) axis = 2;
+		if (n[axis] == 0.0) return false;
+
+		const int ax = (axis + 1) % 3;
+		const int ay = (axis + 2) % 3;
+		const double sign = (n[axis] > 0.0) ? 1.0 : -1.0;
+		retXY.resize(count * 2);
+		for (int i = 0; i < count; ++i) {
+			retXY[i * 2 + 0] = pos[i * 3 + ax] * sign;
+			retXY[i * 2 + 1] = pos[i * 3 + ay];
+		}
+		return true;
+	}
+
+	/**
+	 * 変換行列の各要素 (row-vector形式で p' = p * m).
+	 * 座標の変換では平行移動も加え、法線の変換では回転/スケール成分のみを使用する.
+	 */
+	class CTransform3x4
+	{
+	public:
+		float m[4][3];
+	};
+
+	/**
+	 * 座標を変換 (スカラー版).
+	 * SIMD版と同じ順番で加算するため、結果は同じになる.
+	 */
+	void TransformPointsScalar (float* p, const size_t count, const CTransform3x4& t) {
+		for (size_t i = 0; i < count; ++i, p += 3) {
+			const float x = p[0], y = p[1], z = p[2];
+			p[0] = x * t.m[0][0] + y * t.m[1][0] + z * t.m[2][0] + t.m[3][0];
+			p[1] = x * t.m[0][1] + y * t.m[1][1] + z * t.m[2][1] + t.m[3][1];
+			p[2] = x * t.m[0][2] + y * t.m[1][2] + z * t.m[2][2] + t.m[3][2];
 		}
 	}
 
-	if (flag) {
-		for (int i = 0; i < 4; i++) {
-			for (int j = 0; j < 4; j++) {
-				mat[i][j] = (float)mat_8x4[i][j + 4];
+	/**
+	 * 法線を変換して正規化 (スカラー版).
+	 * 長さが0の場合は変換後の値のままとする.
+	 */
+	void TransformNormalsScalar (float* p, const size_t count, const CTransform3x4& t) {
+		for (size_t i = 0; i < count; ++i, p += 3) {
+			const float x = p[0], y = p[1], z = p[2];
+			const float nx = x * t.m[0][0] + y * t.m[1][0] + z * t.m[2][0];
+			const float ny = x * t.m[0][1] + y * t.m[1][1] + z * t.m[2][1];
+			const float nz = x * t.m[0][2] + y * t.m[1][2] + z * t.m[2][2];
+			const float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+			if (len > 0.0f) {
+				p[0] = nx / len;
+				p[1] = ny / len;
+				p[2] = nz / len;
+			} else {
+				p[0] = nx;
+				p[1] = ny;
+				p[2] = nz;
 			}
 		}
-	} else {
-		//単位行列を求める
-		mat = sxsdk::mat4::identity;
 	}
 
-	retM = mat;
+#ifdef MATHUTIL_USE_SSE2
+	/**
+	 * xyzが連続した4個のベクトル(AoS)を、x/y/zごとの4要素(SoA)に並べ替え.
+	 * a = (x0 y0 z0 x1), b = (y1 z1 x2 y2), c = (z2 x3 y3 z3).
+	 */
+	inline void LoadSoA4 (const float* p, __m128& x, __m128& y, __m128& z) {
+		const __m128 a = _mm_loadu_ps(p);
+		const __m128 b = _mm_loadu_ps(p + 4);
+		const __m128 c = _mm_loadu_ps(p + 8);
+		const __m128 u = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));		// (b2 b3 c1 c2).
+		x = _mm_shuffle_ps(a, u, _MM_SHUFFLE(2, 0, 3, 0));					// (a0 a3 b2 c1).
+		y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), u, _MM_SHUFFLE(3, 1, 2, 0));	// (a1 b0 b3 c2).
+		z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));	// (a2 b1 c0 c3).
+	}
+
+	/**
+	 * x/y/zごとの4要素(SoA)を、xyzが連続した4個のベクトル(AoS)に戻して格納.
+	 */
+	inline void StoreSoA4 (float* p, const __m128& x, const __m128& y, const __m128& z) {
+		const __m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		_mm_storeu_ps(p, a);
+		_mm_storeu_ps(p + 4, b);
+		_mm_storeu_ps(p + 8, c);
+	}
+
+	/**
+	 * 座標を4個ずつ変換 (SSE2).
+	 * @return 処理した個数 (4の倍数).
+	 */
+	size_t TransformPointsSSE2 (float* p, const size_t count, const CTransform3x4& t) {
+		__m128 m[4][3];
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 3; ++j) m[i][j] = _mm_set1_ps(t.m[i][j]);
+		}
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4, p += 12) {
+			__m128 x, y, z;
+			LoadSoA4(p, x, y, z);
+			const __m128 nx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][0]), _mm_mul_ps(y, m[1][0])), _mm_mul_ps(z, m[2][0])), m[3][0]);
+			const __m128 ny = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][1]), _mm_mul_ps(y, m[1][1])), _mm_mul_ps(z, m[2][1])), m[3][1]);
+			const __m128 nz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][2]), _mm_mul_ps(y, m[1][2])), _mm_mul_ps(z, m[2][2])), m[3][2]);
+			StoreSoA4(p, nx, ny, nz);
+		}
+		return i;
+	}
+
+	/**
+	 * 法線を4個ずつ変換して正規化 (SSE2).
+	 * @return 処理した個数 (4の倍数).
+	 */
+	size_t TransformNormalsSSE2 (float* p, const size_t count, const CTransform3x4& t) {
+		__m128 m[3][3];
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) m[i][j] = _mm_set1_ps(t.m[i][j]);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4, p += 12) {
+			__m128 x, y, z;
+			LoadSoA4(p, x, y, z);
+			__m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][0]), _mm_mul_ps(y, m[1][0])), _mm_mul_ps(z, m[2][0]));
+			__m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][1]), _mm_mul_ps(y, m[1][1])), _mm_mul_ps(z, m[2][1]));
+			__m128 nz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][2]), _mm_mul_ps(y, m[1][2])), _mm_mul_ps(z, m[2][2]));
+
+			// 長さが0の要素は割らずにそのままとする.
+			const __m128 len  = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+			const __m128 mask = _mm_cmpgt_ps(len, zero);
+			nx = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(nx, len)), _mm_andnot_ps(mask, nx));
+			ny = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(ny, len)), _mm_andnot_ps(mask, ny));
+			nz = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(nz, len)), _mm_andnot_ps(mask, nz));
+			StoreSoA4(p, nx, ny, nz);
+		}
+		return i;
+	}
+#endif
+
+#ifdef MATHUTIL_USE_AVX
+	/**
+	 * CPUとOSがAVXに対応しているか.
+	 */
+	bool DetectAVX () {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) return false;		// OSXSAVE/AVX.
+		return (_xgetbv(0) & 6) == 6;												// XMM/YMMの状態をOSが保存するか.
+#else
+		unsigned int a, b, c, d;
+		if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+		if (!(c & (1 << 27)) || !(c & (1 << 28))) return false;
+		unsigned int xcr0Low, xcr0High;
+		__asm__ ("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+		return (xcr0Low & 6) == 6;
+#endif
+	}
+
+	const bool g_hasAVX = DetectAVX();
+
+	/**
+	 * 座標を8個ずつ変換 (AVX).
+	 * 4個ずつSoAに並べ替えたものを256bitにまとめて計算する.
+	 * @return 処理した個数 (8の倍数).
+	 */
+	MATHUTIL_TARGET_AVX size_t TransformPointsAVX (float* p, const size_t count, const CTransform3x4& t) {
+		__m256 m[4][3];
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 3; ++j) m[i][j] = _mm256_set1_ps(t.m[i][j]);
+		}
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8, p += 24) {
+			__m128 x0, y0, z0, x1, y1, z1;
+			LoadSoA4(p, x0, y0, z0);
+			LoadSoA4(p + 12, x1, y1, z1);
+			const __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+			const __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+			const __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+			const __m256 nx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][0]), _mm256_mul_ps(y, m[1][0])), _mm256_mul_ps(z, m[2][0])), m[3][0]);
+			const __m256 ny = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][1]), _mm256_mul_ps(y, m[1][1])), _mm256_mul_ps(z, m[2][1])), m[3][1]);
+			const __m256 nz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][2]), _mm256_mul_ps(y, m[1][2])), _mm256_mul_ps(z, m[2][2])), m[3][2]);
+			StoreSoA4(p, _mm256_castps256_ps128(nx), _mm256_castps256_ps128(ny), _mm256_castps256_ps128(nz));
+			StoreSoA4(p + 12, _mm256_extractf128_ps(nx, 1), _mm256_extractf128_ps(ny, 1), _mm256_extractf128_ps(nz, 1));
+		}
+		return i;
+	}
+
+	/**
+	 * 法線を8個ずつ変換して正規化 (AVX).
+	 * @return 処理した個数 (8の倍数).
+	 */
+	MATHUTIL_TARGET_AVX size_t TransformNormalsAVX (float* p, const size_t count, const CTransform3x4& t) {
+		__m256 m[3][3];
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) m[i][j] = _mm256_set1_ps(t.m[i][j]);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8, p += 24) {
+			__m128 x0, y0, z0, x1, y1, z1;
+			LoadSoA4(p, x0, y0, z0);
+			LoadSoA4(p + 12, x1, y1, z1);
+			const __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+			const __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+			const __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+			__m256 nx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][0]), _mm256_mul_ps(y, m[1][0])), _mm256_mul_ps(z, m[2][0]));
+			__m256 ny = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][1]), _mm256_mul_ps(y, m[1][1])), _mm256_mul_ps(z, m[2][1]));
+			__m256 nz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][2]), _mm256_mul_ps(y, m[1][2])), _mm256_mul_ps(z, m[2][2]));
+
+			const __m256 len  = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+			const __m256 mask = _mm256_cmp_ps(len, zero, _CMP_GT_OQ);
+			nx = _mm256_blendv_ps(nx, _mm256_div_ps(nx, len), mask);
+			ny = _mm256_blendv_ps(ny, _mm256_div_ps(ny, len), mask);
+			nz = _mm256_blendv_ps(nz, _mm256_div_ps(nz, len), mask);
+			StoreSoA4(p, _mm256_castps256_ps128(nx), _mm256_castps256_ps128(ny), _mm256_castps256_ps128(nz));
+			StoreSoA4(p + 12, _mm256_extractf128_ps(nx, 1), _mm256_extractf128_ps(ny, 1), _mm256_extractf128_ps(nz, 1));
+		}
+		return i;
+	}
+#endif
+
+	/**
+	 * 2Dでの (b - a) x (c - a).
+	 */
+	inline double Cross2D (const double* a, const double* b, const double* c) {
+		return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+	}
+}
+
+/**
+ * 逆行列計算.
+ * 2x2の小行列式を使った余因子展開で、分岐なしに求める.
+ */
+bool MathUtil::InverseMatrix (const sxsdk::mat4& m, sxsdk::mat4& retM)
+{
+	double a[4][4];
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) a[i][j] = (double)(m[i][j]);
+	}
+
+	// 上2行、下2行の2x2小行列式.
+	const double s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+	const double s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+	const double s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+	const double s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+	const double s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+	const double s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+
+	const double c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+	const double c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+	const double c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+	const double c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+	const double c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+	const double c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+
+	const double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (det == 0.0 || det != det) {
+		retM = sxsdk::mat4::identity;
+		return false;
+	}
+	const double invDet = 1.0 / det;
+
+	double r[4][4];
+	r[0][0] = ( a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * invDet;
+	r[0][1] = (-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3) * invDet;
+	r[0][2] = ( a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * invDet;
+	r[0][3] = (-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3) * invDet;
+
+	r[1][0] = (-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1) * invDet;
+	r[1][1] = ( a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * invDet;
+	r[1][2] = (-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1) * invDet;
+	r[1][3] = ( a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * invDet;
+
+	r[2][0] = ( a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * invDet;
+	r[2][1] = (-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0) * invDet;
+	r[2][2] = ( a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * invDet;
+	r[2][3] = (-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0) * invDet;
 
-	return flag;
+	r[3][0] = (-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0) * invDet;
+	r[3][1] = ( a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * invDet;
+	r[3][2] = (-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0) * invDet;
+	r[3][3] = ( a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * invDet;
+
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) retM[i][j] = (float)r[i][j];
+	}
+	return true;
 }
 
 /**
@@ -311,6 +601,228 @@ double MathUtil::CalcPolygonArea (sxsdk::shade_interface& shade, std::vector<sxs
 	return area;
 }
 
+/**
+ * NaN/Infを含む頂点を検出.
+ * 通常はすべての頂点が有効なため、まず配列全体をまとめて判定し、含まれる場合のみ頂点ごとに判定する.
+ */
+int MathUtil::FindInvalidVertices (const std::vector<sxsdk::vec3>& vertices, std::vector<char>& retInvalid)
+{
+	retInvalid.clear();
+	const int vCou = (int)vertices.size();
+	if (vCou == 0) return 0;
+
+	if (sizeof(sxsdk::vec3) == sizeof(float) * 3) {
+		if (!HasInvalidFloat(&(vertices[0].x), (size_t)vCou * 3)) return 0;
+	}
+
+	int invalidCou = 0;
+	retInvalid.resize(vCou, 0);
+	for (int i = 0; i < vCou; ++i) {
+		const sxsdk::vec3& v = vertices[i];
+		if (IsInvalidFloat(v.x) || IsInvalidFloat(v.y) || IsInvalidFloat(v.z)) {
+			retInvalid[i] = 1;
+			invalidCou++;
+		}
+	}
+	if (invalidCou == 0) retInvalid.clear();
+	return invalidCou;
+}
+
+/**
+ * 座標をまとめて変換.
+ * SIMDで処理できない端数と、射影成分を持つ行列の場合はスカラーで変換する.
+ */
+void MathUtil::TransformPoints (sxsdk::vec3* points, const int count, const sxsdk::mat4& m)
+{
+	if (count <= 0) return;
+
+	// 平行移動/回転/スケールのみの行列でない場合は、wで割る必要があるためSDKの演算を使用.
+	if (m[0][3] != 0.0f || m[1][3] != 0.0f || m[2][3] != 0.0f || m[3][3] != 1.0f || sizeof(sxsdk::vec3) != sizeof(float) * 3) {
+		for (int i = 0; i < count; ++i) points[i] = points[i] * m;
+		return;
+	}
+
+	CTransform3x4 t;
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 3; ++j) t.m[i][j] = m[i][j];
+	}
+	float* p = &(points[0].x);
+	size_t done = 0;
+#ifdef MATHUTIL_USE_AVX
+	if (g_hasAVX) done = TransformPointsAVX(p, (size_t)count, t);
+#endif
+#ifdef MATHUTIL_USE_SSE2
+	done += TransformPointsSSE2(p + done * 3, (size_t)count - done, t);
+#endif
+	TransformPointsScalar(p + done * 3, (size_t)count - done, t);
+}
+
+/**
+ * 法線をまとめて変換して正規化.
+ */
+void MathUtil::TransformNormals (sxsdk::vec3* normals, const int count, const sxsdk::mat4& m)
+{
+	if (count <= 0) return;
+
+	if (sizeof(sxsdk::vec3) != sizeof(float) * 3) {
+		for (int i = 0; i < count; ++i) {
+			const sxsdk::vec4 v4 = sxsdk::vec4(normals[i], 0) * m;
+			normals[i] = normalize(sxsdk::vec3(v4.x, v4.y, v4.z));
+		}
+		return;
+	}
+
+	CTransform3x4 t;
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 3; ++j) t.m[i][j] = (i < 3) ? m[i][j] : 0.0f;
+	}
+	float* p = &(normals[0].x);
+	size_t done = 0;
+#ifdef MATHUTIL_USE_AVX
+	if (g_hasAVX) done = TransformNormalsAVX(p, (size_t)count, t);
+#endif
+#ifdef MATHUTIL_USE_SSE2
+	done += TransformNormalsSSE2(p + done * 3, (size_t)count - done, t);
+#endif
+	TransformNormalsScalar(p + done * 3, (size_t)count - done, t);
+}
+
+/**
+ * 多角形に面積がないかを判定.
+ * 桁落ちを避けるため、先頭の頂点からの相対位置で計算する.
+ */
+bool MathUtil::IsDegeneratePolygon (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count)
+{
+	if (count <= 2) return true;
+
+	const sxsdk::vec3& v0 = vertices[ indices[0] ];
+	double nx = 0.0, ny = 0.0, nz = 0.0;
+	double edgeLenSq = 0.0;
+	double ax = 0.0, ay = 0.0, az = 0.0;			// 先頭の頂点は原点.
+	for (int i = 0; i < count; ++i) {
+		const sxsdk::vec3& v = vertices[ indices[(i + 1) % count] ];
+		const double bx = (double)v.x - (double)v0.x;
+		const double by = (double)v.y - (double)v0.y;
+		const double bz = (double)v.z - (double)v0.z;
+		nx += (ay - by) * (az + bz);
+		ny += (az - bz) * (ax + bx);
+		nz += (ax - bx) * (ay + by);
+		edgeLenSq += (ax - bx) * (ax - bx) + (ay - by) * (ay - by) + (az - bz) * (az - bz);
+		ax = bx;
+		ay = by;
+		az = bz;
+	}
+	if (edgeLenSq <= 0.0) return true;
+
+	// 法線の長さは面積の2倍。辺の長さの2乗和に対して十分小さい場合は面積なしとする.
+	const double ratio = 1e-6;
+	return (nx * nx + ny * ny + nz * nz) <= (ratio * edgeLenSq) * (ratio * edgeLenSq);
+}
+
+/**
+ * 多角形が平面上にある凸多角形かを判定.
+ * 平面からの距離が辺の長さの平均の1/1000以下であれば、平面上にあるとみなす.
+ */
+bool MathUtil::IsConvexPlanarPolygon (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count, CPolygonWork& work)
+{
+	if (count <= 3) return true;
+
+	std::vector<double>& xy = work.xy;
+	if (!ProjectPolygon2D(vertices, indices, count, work.pos, xy)) return false;
+
+	// 各頂点で曲がる向きがすべて同じで、1周で曲がる角度の合計が360度であれば凸.
+	double angleSum = 0.0;
+	for (int i = 0; i < count; ++i) {
+		const double* a = &xy[((i + count - 1) % count) * 2];
+		const double* b = &xy[i * 2];
+		const double* c = &xy[((i + 1) % count) * 2];
+		const double cross = Cross2D(a, b, c);
+		if (cross < 0.0) return false;
+		const double dot = (b[0] - a[0]) * (c[0] - b[0]) + (b[1] - a[1]) * (c[1] - b[1]);
+		angleSum += std::atan2(cross, dot);
+	}
+	if (std::abs(angleSum - 2.0 * (double)sx::pi) > 1e-3) return false;
+
+	// 平面からの距離を判定.
+	const sxsdk::vec3& v0 = vertices[ indices[0] ];
+	double nx = 0.0, ny = 0.0, nz = 0.0;
+	double edgeLen = 0.0;
+	for (int i = 0; i < count; ++i) {
+		const sxsdk::vec3& a = vertices[ indices[i] ];
+		const sxsdk::vec3& b = vertices[ indices[(i + 1) % count] ];
+		const double ax = (double)a.x - (double)v0.x, ay = (double)a.y - (double)v0.y, az = (double)a.z - (double)v0.z;
+		const double bx = (double)b.x - (double)v0.x, by = (double)b.y - (double)v0.y, bz = (double)b.z - (double)v0.z;
+		nx += (ay - by) * (az + bz);
+		ny += (az - bz) * (ax + bx);
+		nz += (ax - bx) * (ay + by);
+		edgeLen += std::sqrt((ax - bx) * (ax - bx) + (ay - by) * (ay - by) + (az - bz) * (az - bz));
+	}
+	const double nLen = std::sqrt(nx * nx + ny * ny + nz * nz);
+	if (nLen <= 0.0) return false;
+	const double maxDist = (edgeLen / (double)count) * 1e-3;
+	for (int i = 1; i < count; ++i) {
+		const sxsdk::vec3& v = vertices[ indices[i] ];
+		const double dist = ((double)v.x - (double)v0.x) * nx + ((double)v.y - (double)v0.y) * ny + ((double)v.z - (double)v0.z) * nz;
+		if (std::abs(dist) > maxDist * nLen) return false;
+	}
+	return true;
+}
+
+/**
+ * 多角形を三角形に分割 (耳刈り取り法).
+ * 自己交差などで耳が見つからない場合は、凸の頂点(なければ先頭の頂点)を切り取って続ける.
+ */
+bool MathUtil::TriangulatePolygon (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count, std::vector<int>& retTriangles, CPolygonWork& work)
+{
+	retTriangles.clear();
+	if (count <= 2) return false;
+
+	std::vector<double>& xy = work.xy;
+	if (!ProjectPolygon2D(vertices, indices, count, work.pos, xy)) return false;
+
+	retTriangles.reserve((count - 2) * 3);
+	std::vector<int>& remain = work.remain;
+	remain.resize(count);
+	for (int i = 0; i < count; ++i) remain[i] = i;
+
+	while (remain.size() > 3) {
+		const int rCou = (int)remain.size();
+		int earPos = -1;
+		int convexPos = -1;
+		for (int i = 0; i < rCou && earPos < 0; ++i) {
+			const int i0 = remain[(i + rCou - 1) % rCou];
+			const int i1 = remain[i];
+			const int i2 = remain[(i + 1) % rCou];
+			const double* a = &xy[i0 * 2];
+			const double* b = &xy[i1 * 2];
+			const double* c = &xy[i2 * 2];
+			if (Cross2D(a, b, c) <= 0.0) continue;
+			if (convexPos < 0) convexPos = i;
+
+			// 他の頂点が三角形の内側(辺上を含む)にない場合は耳.
+			bool ear = true;
+			for (int j = 0; j < rCou && ear; ++j) {
+				const int k = remain[j];
+				if (k == i0 || k == i1 || k == i2) continue;
+				const double* p = &xy[k * 2];
+				if (Cross2D(a, b, p) >= 0.0 && Cross2D(b, c, p) >= 0.0 && Cross2D(c, a, p) >= 0.0) ear = false;
+			}
+			if (ear) earPos = i;
+		}
+		if (earPos < 0) earPos = (convexPos >= 0) ? convexPos : 0;
+
+		retTriangles.push_back(remain[(earPos + rCou - 1) % rCou]);
+		retTriangles.push_back(remain[earPos]);
+		retTriangles.push_back(remain[(earPos + 1) % rCou]);
+		remain.erase(remain.begin() + earPos);
+	}
+	retTriangles.push_back(remain[0]);
+	retTriangles.push_back(remain[1]);
+	retTriangles.push_back(remain[2]);
+
+	return true;
+}
+
 /**
  * ガンマ補正した色を計算.
  */
@@ -28,7 +28,20 @@ public:
 namespace MathUtil
 {
 	/**
-	 * ガウスの消去法で逆行列計算.
+	 * 多角形の判定/三角形分割で使用する作業領域.
+	 * 面ごとにメモリ確保しないように、呼び出し側で保持して使い回す.
+	 */
+	class CPolygonWork
+	{
+	public:
+		std::vector<double> pos;		// 先頭の頂点からの相対位置 (xyz).
+		std::vector<double> xy;			// 2Dに投影した座標.
+		std::vector<int> remain;		// 三角形分割で残っている頂点の順番.
+	};
+
+	/**
+	 * 逆行列計算 (余因子展開による閉形式).
+	 * 逆行列が存在しない場合は単位行列を返し、falseを返す.
 	 */
 	bool InverseMatrix (const sxsdk::mat4& m, sxsdk::mat4& retM);
 
@@ -53,6 +66,46 @@ namespace MathUtil
 	 */
 	double CalcPolygonArea (sxsdk::shade_interface& shade, std::vector<sxsdk::vec3>& polygon);
 
+	/**
+	 * NaN/Infを含む頂点を検出.
+	 * SSE2が使用できる場合は、頂点配列全体を4要素ずつまとめて判定する.
+	 * @param[out] retInvalid  頂点ごとに、NaN/Infを含む場合は1 (不正な頂点がない場合は空).
+	 * @return 不正な頂点数.
+	 */
+	int FindInvalidVertices (const std::vector<sxsdk::vec3>& vertices, std::vector<char>& retInvalid);
+
+	/**
+	 * 座標をまとめて変換 (points[i] * m).
+	 * SSE2が使用できる場合は4個ずつ、実行時にAVXが使用できる場合は8個ずつ、x/y/zごとに並べ替えて変換する.
+	 */
+	void TransformPoints (sxsdk::vec3* points, const int count, const sxsdk::mat4& m);
+
+	/**
+	 * 法線をまとめて変換して正規化 (mの回転/スケール成分のみを使用).
+	 * 長さが0の法線はそのままとする.
+	 */
+	void TransformNormals (sxsdk::vec3* normals, const int count, const sxsdk::mat4& m);
+
+	/**
+	 * 多角形に面積がないかを判定 (Newell法で求めた法線の長さを、辺の長さに対する比で判定).
+	 * 頂点数によらず、重複した頂点や一直線上に並んだ頂点のみの面を検出する.
+	 */
+	bool IsDegeneratePolygon (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count);
+
+	/**
+	 * 多角形が平面上にある凸多角形かを判定.
+	 * RIBのPointsPolygonsにそのまま渡せる面かどうかの判定に使用する.
+	 */
+	bool IsConvexPlanarPolygon (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count, CPolygonWork& work);
+
+	/**
+	 * 多角形を三角形に分割 (耳刈り取り法).
+	 * 凹多角形も、面の向きを保ったまま分割する.
+	 * @param[out] retTriangles  三角形ごとの、多角形の頂点の順番(0 - (count - 1))を3つずつ格納.
+	 * @return 面積がなく分割できない場合はfalse.
+	 */
+	bool TriangulatePolygon (const std::vector<sxsdk::vec3>& vertices, const int* indices, const int count, std::vector<int>& retTriangles, CPolygonWork& work);
+
 	/**
 	 * ガンマ補正した色を計算.
 	 */
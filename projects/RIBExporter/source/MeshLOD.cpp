@@ -0,0 +1,404 @@
+﻿/**
+ * 画面上の大きさに応じたポリゴンメッシュの簡略化 (LOD).
+ */
+
+#include "MeshLOD.h"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+
+#define MESH_LOD_MAX_ERROR_RATE		0.25		// 目標とする辺の長さに対する、許容する誤差の割合.
+#define MESH_LOD_MIN_REDUCTION		0.75		// 三角形数がこの割合以下にならない場合は、簡略化しない.
+
+namespace {
+	/**
+	 * 誤差行列(対称4x4の10要素)での、位置vでの誤差.
+	 */
+	inline double EvalQuadric (const double* q, const sxsdk::vec3& p) {
+		const double x = p.x, y = p.y, z = p.z;
+		return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+		     + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+		     + q[7] * z * z + 2.0 * q[8] * z
+		     + q[9];
+	}
+
+	inline sxsdk::vec3 CalcTriangleNormal (const sxsdk::vec3& p0, const sxsdk::vec3& p1, const sxsdk::vec3& p2) {
+		const sxsdk::vec3 e1 = p1 - p0;
+		const sxsdk::vec3 e2 = p2 - p0;
+		return sxsdk::vec3(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+	}
+
+	inline double Dot (const sxsdk::vec3& a, const sxsdk::vec3& b) {
+		return (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+	}
+}
+
+CMeshLOD::CMeshLOD (const CMeshLODParam& param) : m_param(param)
+{
+	m_maxEdgeLength = 0.0;
+	m_maxCost       = 0.0;
+}
+
+/**
+ * 簡略化を行う.
+ */
+bool CMeshLOD::Run (COutputMeshInfo& meshInfo)
+{
+	if (!m_param.IsEnabled() || meshInfo.GetFacesCount() == 0) return false;
+
+	m_maxEdgeLength = m_CalcTargetEdgeLength(meshInfo);
+	if (m_maxEdgeLength <= 0.0) return false;
+	m_maxCost = (m_maxEdgeLength * MESH_LOD_MAX_ERROR_RATE) * (m_maxEdgeLength * MESH_LOD_MAX_ERROR_RATE);
+
+	m_Setup(meshInfo);
+	const int triCou = (int)m_triangles.size();
+
+	// 縮約の候補を誤差の小さい順に処理.
+	std::vector<CCollapse> heap;
+	for (int i = 0; i < triCou; i++) {
+		const CTriangle& tri = m_triangles[i];
+		for (int j = 0; j < 3; j++) {
+			m_PushCollapse(heap, meshInfo, tri.v[j], tri.v[(j + 1) % 3]);
+			m_PushCollapse(heap, meshInfo, tri.v[(j + 1) % 3], tri.v[j]);
+		}
+	}
+
+	std::vector<int> neighbors;
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), std::greater<CCollapse>());
+		const CCollapse c = heap.back();
+		heap.pop_back();
+
+		if (m_removedVertices[c.u] || m_removedVertices[c.v]) continue;
+		if (m_stamps[c.u] != c.stampU || m_stamps[c.v] != c.stampV) continue;
+
+		if (!m_Collapse(meshInfo, c.u, c.v)) continue;
+
+		// 縮約先の頂点の周囲の辺を、候補として追加し直す.
+		neighbors.clear();
+		const std::vector<int>& tv = m_vertexTriangles[c.v];
+		for (size_t i = 0; i < tv.size(); i++) {
+			const CTriangle& tri = m_triangles[ tv[i] ];
+			for (int j = 0; j < 3; j++) {
+				if (tri.v[j] != c.v) neighbors.push_back(tri.v[j]);
+			}
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		for (size_t i = 0; i < neighbors.size(); i++) {
+			m_PushCollapse(heap, meshInfo, c.v, neighbors[i]);
+			m_PushCollapse(heap, meshInfo, neighbors[i], c.v);
+		}
+	}
+
+	int newTriCou = 0;
+	for (int i = 0; i < triCou; i++) {
+		if (!m_triangles[i].removed) newTriCou++;
+	}
+	if ((double)newTriCou > (double)triCou * MESH_LOD_MIN_REDUCTION) return false;
+
+	m_Rebuild(meshInfo);
+	return true;
+}
+
+/**
+ * メッシュの画面上の大きさから、目標とする辺の長さを計算.
+ * バウンディングボックス上のカメラに最も近い位置での、targetPixelsピクセルに相当する長さとする.
+ */
+double CMeshLOD::m_CalcTargetEdgeLength (const COutputMeshInfo& meshInfo) const
+{
+	const std::vector<sxsdk::vec3>& vertices = meshInfo.vertices;
+	if (vertices.empty()) return 0.0;
+
+	sxsdk::vec3 bbMin = vertices[0];
+	sxsdk::vec3 bbMax = vertices[0];
+	for (size_t i = 1; i < vertices.size(); ++i) {
+		const sxsdk::vec3& v = vertices[i];
+		bbMin.x = std::min(bbMin.x, v.x);
+		bbMin.y = std::min(bbMin.y, v.y);
+		bbMin.z = std::min(bbMin.z, v.z);
+		bbMax.x = std::max(bbMax.x, v.x);
+		bbMax.y = std::max(bbMax.y, v.y);
+		bbMax.z = std::max(bbMax.z, v.z);
+	}
+
+	const sxsdk::vec3& c = m_param.cameraPosition;
+	const double dx = (double)std::max(bbMin.x - c.x, std::max(0.0f, c.x - bbMax.x));
+	const double dy = (double)std::max(bbMin.y - c.y, std::max(0.0f, c.y - bbMax.y));
+	const double dz = (double)std::max(bbMin.z - c.z, std::max(0.0f, c.z - bbMax.z));
+	const double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+	if (distance <= 0.0) return 0.0;			// カメラがバウンディングボックス内にある.
+
+	const double targetLength = (double)m_param.targetPixels * distance / (double)m_param.pixelsPerUnit;
+
+	// 目標より短い辺がほとんどない場合は、簡略化しない.
+	const int faceCou = meshInfo.GetFacesCount();
+	int edgeCou = 0, shortEdgeCou = 0;
+	const double targetLengthSq = targetLength * targetLength;
+	for (int i = 0; i < faceCou; i++) {
+		const int* indices = meshInfo.GetFaceIndices(i);
+		const int vCou     = meshInfo.GetFaceVerticesCount(i);
+		for (int j = 0; j < vCou; j++) {
+			const sxsdk::vec3 e = vertices[ indices[j] ] - vertices[ indices[(j + 1) % vCou] ];
+			if (Dot(e, e) < targetLengthSq) shortEdgeCou++;
+			edgeCou++;
+		}
+	}
+	if ((double)shortEdgeCou < (double)edgeCou * (1.0 - MESH_LOD_MIN_REDUCTION)) return 0.0;
+
+	return targetLength;
+}
+
+/**
+ * 三角形に分割して、頂点ごとの誤差行列と動かさない頂点を計算.
+ */
+void CMeshLOD::m_Setup (const COutputMeshInfo& meshInfo)
+{
+	const int vCou    = (int)meshInfo.vertices.size();
+	const int faceCou = meshInfo.GetFacesCount();
+	const bool facevaryingN = !meshInfo.normalIndices.empty();
+	const bool facevaryingT = !meshInfo.uvIndices.empty();
+
+	// 多角形は先頭の頂点から扇状に三角形に分割.
+	m_triangles.clear();
+	m_triangles.reserve(meshInfo.faceIndices.size());
+	for (int i = 0; i < faceCou; i++) {
+		const int offset = meshInfo.faceOffsets[i];
+		const int cou    = meshInfo.GetFaceVerticesCount(i);
+		for (int j = 1; j + 1 < cou; j++) {
+			const int corners[3] = { offset, offset + j, offset + j + 1 };
+			CTriangle tri;
+			for (int k = 0; k < 3; k++) {
+				tri.v[k] = meshInfo.faceIndices[ corners[k] ];
+				tri.n[k] = facevaryingN ? meshInfo.normalIndices[ corners[k] ] : -1;
+				tri.t[k] = facevaryingT ? meshInfo.uvIndices[ corners[k] ] : -1;
+			}
+			tri.removed = false;
+			m_triangles.push_back(tri);
+		}
+	}
+	const int triCou = (int)m_triangles.size();
+
+	m_vertexTriangles.assign(vCou, std::vector<int>());
+	m_quadrics.assign((size_t)vCou * 10, 0.0);
+	m_locked.assign(vCou, 0);
+	m_removedVertices.assign(vCou, 0);
+	m_stamps.assign(vCou, 0);
+
+	// 境界の辺(1つの三角形のみが参照)と、3つ以上の三角形が参照する辺の頂点は動かさない.
+	// 法線/UVで分離した頂点とfaceGroupの境界は、ここで境界の辺となる.
+	std::unordered_map<long long, int> edgeCounts;
+	edgeCounts.reserve(triCou * 2);
+	std::vector<int> vertexN(vCou, -1), vertexT(vCou, -1);
+	for (int i = 0; i < triCou; i++) {
+		const CTriangle& tri = m_triangles[i];
+		for (int k = 0; k < 3; k++) {
+			const int a = tri.v[k];
+			const int b = tri.v[(k + 1) % 3];
+			edgeCounts[(long long)std::min(a, b) * vCou + std::max(a, b)]++;
+			m_vertexTriangles[a].push_back(i);
+
+			// facevaryingで複数の法線/UVを持つ頂点は動かさない.
+			if (vertexN[a] < 0) vertexN[a] = tri.n[k];
+			else if (vertexN[a] != tri.n[k]) m_locked[a] = 1;
+			if (vertexT[a] < 0) vertexT[a] = tri.t[k];
+			else if (vertexT[a] != tri.t[k]) m_locked[a] = 1;
+		}
+
+		// 三角形の平面からの距離の2乗を、頂点ごとの誤差行列に加える.
+		const sxsdk::vec3& p0 = meshInfo.vertices[ tri.v[0] ];
+		const sxsdk::vec3 n = CalcTriangleNormal(p0, meshInfo.vertices[ tri.v[1] ], meshInfo.vertices[ tri.v[2] ]);
+		const double len = std::sqrt(Dot(n, n));
+		if (len <= 0.0) continue;
+		const double a = n.x / len, b = n.y / len, c = n.z / len;
+		const double d = -(a * p0.x + b * p0.y + c * p0.z);
+		const double q[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+		for (int k = 0; k < 3; k++) {
+			double* dst = &m_quadrics[(size_t)tri.v[k] * 10];
+			for (int j = 0; j < 10; j++) dst[j] += q[j];
+		}
+	}
+	for (std::unordered_map<long long, int>::const_iterator iter = edgeCounts.begin(); iter != edgeCounts.end(); ++iter) {
+		if (iter->second == 2) continue;
+		m_locked[ (int)(iter->first / vCou) ] = 1;
+		m_locked[ (int)(iter->first % vCou) ] = 1;
+	}
+}
+
+/**
+ * 縮約の候補を追加.
+ * 頂点uが動かせない場合、辺が目標より長い場合、誤差が許容値を超える場合は追加しない.
+ */
+void CMeshLOD::m_PushCollapse (std::vector<CCollapse>& heap, const COutputMeshInfo& meshInfo, const int u, const int v) const
+{
+	if (m_locked[u] || m_removedVertices[u] || m_removedVertices[v]) return;
+
+	const sxsdk::vec3& pv = meshInfo.vertices[v];
+	const sxsdk::vec3 e = meshInfo.vertices[u] - pv;
+	if (Dot(e, e) >= m_maxEdgeLength * m_maxEdgeLength) return;
+
+	double q[10];
+	const double* qu = &m_quadrics[(size_t)u * 10];
+	const double* qv = &m_quadrics[(size_t)v * 10];
+	for (int i = 0; i < 10; i++) q[i] = qu[i] + qv[i];
+	const double cost = std::max(0.0, EvalQuadric(q, pv));
+	if (cost > m_maxCost) return;
+
+	CCollapse c;
+	c.cost   = cost;
+	c.u      = u;
+	c.v      = v;
+	c.stampU = m_stamps[u];
+	c.stampV = m_stamps[v];
+	heap.push_back(c);
+	std::push_heap(heap.begin(), heap.end(), std::greater<CCollapse>());
+}
+
+/**
+ * 頂点uを頂点vに縮約できるか判定し、できる場合は縮約する.
+ */
+bool CMeshLOD::m_Collapse (const COutputMeshInfo& meshInfo, const int u, const int v)
+{
+	const std::vector<int>& tu = m_vertexTriangles[u];
+
+	// 辺uvを共有する三角形が2つで、u/vの両方に隣接する頂点がその2つの三角形の頂点のみであること (形状に穴や重なりを作らない).
+	int shared[2] = { -1, -1 };
+	int sharedCou = 0;
+	std::vector<int> nu, nv;
+	for (size_t i = 0; i < tu.size(); i++) {
+		const CTriangle& tri = m_triangles[ tu[i] ];
+		if (tri.removed) continue;
+		if (tri.v[0] == v || tri.v[1] == v || tri.v[2] == v) {
+			if (sharedCou < 2) shared[sharedCou] = tu[i];
+			sharedCou++;
+		}
+		for (int k = 0; k < 3; k++) {
+			if (tri.v[k] != u && tri.v[k] != v) nu.push_back(tri.v[k]);
+		}
+	}
+	if (sharedCou != 2) return false;
+
+	const std::vector<int>& tv = m_vertexTriangles[v];
+	for (size_t i = 0; i < tv.size(); i++) {
+		const CTriangle& tri = m_triangles[ tv[i] ];
+		if (tri.removed) continue;
+		for (int k = 0; k < 3; k++) {
+			if (tri.v[k] != u && tri.v[k] != v) nv.push_back(tri.v[k]);
+		}
+	}
+	std::sort(nu.begin(), nu.end());
+	nu.erase(std::unique(nu.begin(), nu.end()), nu.end());
+	std::sort(nv.begin(), nv.end());
+	nv.erase(std::unique(nv.begin(), nv.end()), nv.end());
+	{
+		std::vector<int> common;
+		std::set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(), std::back_inserter(common));
+		if (common.size() != 2) return false;
+	}
+
+	// 縮約後の頂点vでの法線/UV番号 (辺uvを共有する2つの三角形で同じであること).
+	int repN = -1, repT = -1;
+	for (int i = 0; i < 2; i++) {
+		const CTriangle& tri = m_triangles[ shared[i] ];
+		for (int k = 0; k < 3; k++) {
+			if (tri.v[k] != v) continue;
+			if (i == 0) {
+				repN = tri.n[k];
+				repT = tri.t[k];
+			} else if (repN != tri.n[k] || repT != tri.t[k]) {
+				return false;
+			}
+		}
+	}
+
+	// 移動により、面が裏返る場合/面積がなくなる場合は縮約しない.
+	const sxsdk::vec3& pv = meshInfo.vertices[v];
+	for (size_t i = 0; i < tu.size(); i++) {
+		const CTriangle& tri = m_triangles[ tu[i] ];
+		if (tri.removed || tri.v[0] == v || tri.v[1] == v || tri.v[2] == v) continue;
+
+		sxsdk::vec3 p[3];
+		for (int k = 0; k < 3; k++) p[k] = meshInfo.vertices[ tri.v[k] ];
+		const sxsdk::vec3 nBefore = CalcTriangleNormal(p[0], p[1], p[2]);
+		for (int k = 0; k < 3; k++) {
+			if (tri.v[k] == u) p[k] = pv;
+		}
+		const sxsdk::vec3 nAfter = CalcTriangleNormal(p[0], p[1], p[2]);
+		const double d = Dot(nBefore, nAfter);
+		if (d <= 0.0 || d * d < 0.25 * Dot(nBefore, nBefore) * Dot(nAfter, nAfter)) return false;		// 60度以上傾く場合も除外.
+	}
+
+	// 縮約.
+	for (size_t i = 0; i < tu.size(); i++) {
+		CTriangle& tri = m_triangles[ tu[i] ];
+		if (tri.removed) continue;
+		if (tri.v[0] == v || tri.v[1] == v || tri.v[2] == v) {
+			tri.removed = true;
+			continue;
+		}
+		for (int k = 0; k < 3; k++) {
+			if (tri.v[k] != u) continue;
+			tri.v[k] = v;
+			tri.n[k] = repN;
+			tri.t[k] = repT;
+		}
+		m_vertexTriangles[v].push_back(tu[i]);
+	}
+	{
+		std::vector<int>& list = m_vertexTriangles[v];
+		size_t cou = 0;
+		for (size_t i = 0; i < list.size(); i++) {
+			if (!m_triangles[ list[i] ].removed) list[cou++] = list[i];
+		}
+		list.resize(cou);
+	}
+	std::vector<int>().swap(m_vertexTriangles[u]);
+
+	double* qu = &m_quadrics[(size_t)u * 10];
+	double* qv = &m_quadrics[(size_t)v * 10];
+	for (int i = 0; i < 10; i++) qv[i] += qu[i];
+	m_removedVertices[u] = 1;
+	m_stamps[v]++;
+
+	return true;
+}
+
+/**
+ * 縮約後の三角形から、出力用のポリゴンメッシュ情報を作り直す.
+ * 法線/UVが頂点ごとの場合は頂点と同じ番号で詰め直し、facevaryingの場合は値のリストをそのまま使用する.
+ */
+void CMeshLOD::m_Rebuild (COutputMeshInfo& meshInfo) const
+{
+	const int vCou = (int)meshInfo.vertices.size();
+	const bool facevaryingN = !meshInfo.normalIndices.empty();
+	const bool facevaryingT = !meshInfo.uvIndices.empty();
+
+	std::vector<int> newIndices(vCou, -1);
+	COutputMeshInfo newMeshInfo;
+	newMeshInfo.faceGroupIndex = meshInfo.faceGroupIndex;
+	if (facevaryingN) newMeshInfo.normals.swap(meshInfo.normals);
+	if (facevaryingT) newMeshInfo.uvs.swap(meshInfo.uvs);
+
+	for (size_t i = 0; i < m_triangles.size(); i++) {
+		const CTriangle& tri = m_triangles[i];
+		if (tri.removed) continue;
+		for (int k = 0; k < 3; k++) {
+			const int index = tri.v[k];
+			if (newIndices[index] < 0) {
+				newIndices[index] = (int)newMeshInfo.vertices.size();
+				newMeshInfo.vertices.push_back(meshInfo.vertices[index]);
+				if (!facevaryingN) newMeshInfo.normals.push_back(meshInfo.normals[index]);
+				if (!facevaryingT) newMeshInfo.uvs.push_back(meshInfo.uvs[index]);
+			}
+			newMeshInfo.faceIndices.push_back(newIndices[index]);
+			if (facevaryingN) newMeshInfo.normalIndices.push_back(tri.n[k]);
+			if (facevaryingT) newMeshInfo.uvIndices.push_back(tri.t[k]);
+		}
+		newMeshInfo.faceOffsets.push_back((int)newMeshInfo.faceIndices.size());
+	}
+
+	meshInfo = newMeshInfo;
+}
@@ -0,0 +1,118 @@
+﻿/**
+ * 画面上の大きさに応じたポリゴンメッシュの簡略化 (LOD).
+ * カメラから遠く、画面上で小さく表示される形状の面数を、Quadric Error Metricsによる辺の縮約で減らす.
+ * Shade3DのSDKを呼ばないため、ワーカースレッドで実行できる.
+ */
+
+#ifndef _MESHLOD_H
+#define _MESHLOD_H
+
+#include "GlobalHeader.h"
+#include "PolygonMeshCtrl.h"
+
+/**
+ * 簡略化のパラメータ.
+ */
+class CMeshLODParam
+{
+public:
+	float targetPixels;					// 簡略化後の辺の長さの目安 (ピクセル数。0の場合は簡略化しない).
+	float pixelsPerUnit;				// カメラからの距離が1のときの、1単位あたりのピクセル数.
+	sxsdk::vec3 cameraPosition;			// ワールド座標でのカメラ位置.
+
+public:
+	CMeshLODParam () {
+		targetPixels   = 0.0f;
+		pixelsPerUnit  = 0.0f;
+		cameraPosition = sxsdk::vec3(0, 0, 0);
+	}
+
+	/**
+	 * 簡略化を行うか.
+	 */
+	bool IsEnabled () const { return (targetPixels > 0.0f && pixelsPerUnit > 0.0f); }
+};
+
+/**
+ * ポリゴンメッシュの簡略化.
+ * 境界の辺上の頂点(faceGroupの境界、法線/UVで分離した頂点)と、
+ * facevaryingで複数の法線/UVを持つ頂点は動かさないため、UVの境界や形状の輪郭は保持される.
+ */
+class CMeshLOD
+{
+private:
+	/**
+	 * 三角形.
+	 */
+	class CTriangle
+	{
+	public:
+		int v[3];						// 頂点番号.
+		int n[3];						// facevaryingの場合の法線番号.
+		int t[3];						// facevaryingの場合のUV番号.
+		bool removed;					// 縮約により削除された場合はtrue.
+	};
+
+	/**
+	 * 縮約の候補 (頂点uを頂点vの位置に移動).
+	 */
+	class CCollapse
+	{
+	public:
+		double cost;					// 誤差.
+		int u, v;
+		int stampU, stampV;				// 候補作成時の頂点の更新回数 (更新された場合は無効).
+
+		bool operator > (const CCollapse& c) const { return cost > c.cost; }
+	};
+
+	CMeshLODParam m_param;
+
+	std::vector<CTriangle> m_triangles;					// 三角形.
+	std::vector< std::vector<int> > m_vertexTriangles;	// 頂点ごとの三角形番号 (削除済みの三角形も含む).
+	std::vector<double> m_quadrics;						// 頂点ごとの誤差行列 (対称4x4の10要素).
+	std::vector<char> m_locked;							// 動かさない頂点の場合は1.
+	std::vector<char> m_removedVertices;				// 縮約により削除された頂点の場合は1.
+	std::vector<int> m_stamps;							// 頂点の更新回数.
+
+	double m_maxEdgeLength;								// 縮約する辺の長さの最大.
+	double m_maxCost;									// 縮約を許容する誤差の最大.
+
+	/**
+	 * メッシュの画面上の大きさから、目標とする辺の長さを計算.
+	 * @return 簡略化の必要がない場合は0.
+	 */
+	double m_CalcTargetEdgeLength (const COutputMeshInfo& meshInfo) const;
+
+	/**
+	 * 三角形に分割して、頂点ごとの誤差行列と動かさない頂点を計算.
+	 */
+	void m_Setup (const COutputMeshInfo& meshInfo);
+
+	/**
+	 * 縮約の候補を追加.
+	 */
+	void m_PushCollapse (std::vector<CCollapse>& heap, const COutputMeshInfo& meshInfo, const int u, const int v) const;
+
+	/**
+	 * 頂点uを頂点vに縮約できるか判定し、できる場合は縮約する.
+	 */
+	bool m_Collapse (const COutputMeshInfo& meshInfo, const int u, const int v);
+
+	/**
+	 * 縮約後の三角形から、出力用のポリゴンメッシュ情報を作り直す.
+	 */
+	void m_Rebuild (COutputMeshInfo& meshInfo) const;
+
+public:
+	CMeshLOD (const CMeshLODParam& param);
+
+	/**
+	 * 簡略化を行う.
+	 * 面数が十分に減らない場合は、元の情報のままとする.
+	 * @return 簡略化した場合はtrue.
+	 */
+	bool Run (COutputMeshInfo& meshInfo);
+};
+
+#endif
@@ -0,0 +1,363 @@
+﻿/**
+ * ポリゴンメッシュの出力処理.
+ */
+
+#include "MeshOutput.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#define RIB_GEOMETRY_ARCHIVE_VERSION	0x101		// 形状アーカイブの出力内容のバージョン (出力内容を変更した場合は上げて、キャッシュを無効にする).
+#define RIB_MESH_OUTPUT_CHUNK_SIZE		4096		// 配列を分割して出力する際の要素数.
+
+CMeshOutputJob::CMeshOutputJob (const std::shared_ptr<const CPolygonMeshCtrl>& meshCtrl, const int faceGroupIndex, const CMeshOutputParam& param) : m_meshCtrl(meshCtrl), m_faceGroupIndex(faceGroupIndex), m_param(param)
+{
+	m_done = false;
+	m_archiveBytes = 0;
+}
+
+/**
+ * 出力処理を実行.
+ * 失敗した場合、出力内容は空になりエラー内容を保持する.
+ */
+void CMeshOutputJob::Run ()
+{
+	{
+		CRIBWriter writer(NULL, m_param.encoding);
+		if (Write(writer)) writer.GetData(m_output);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done = true;
+	}
+	m_condition.notify_all();
+}
+
+/**
+ * 指定の出力先に直接出力.
+ * 出力先がファイル/streamの場合は、出力内容をメモリ上に保持しない.
+ */
+bool CMeshOutputJob::Write (CRIBWriter& writer)
+{
+	try {
+		m_Write(writer);
+		return true;
+	} catch (const std::exception& e) {
+		m_error = m_param.name + " : " + e.what();
+	} catch (...) {
+		m_error = m_param.name + " : unknown error";
+	}
+
+	// 大きな形状でメモリを確保できなかった場合などに、格納したメッシュ情報を保持し続けない.
+	m_meshCtrl.reset();
+	return false;
+}
+
+/**
+ * 頂点の分離、簡略化を行い、指定の出力先に出力.
+ */
+void CMeshOutputJob::m_Write (CRIBWriter& writer)
+{
+	CExportProfiler::CScope scope(m_param.profiler, m_param.name, "mesh", m_param.shapeID);
+	const size_t startBytes = writer.GetTotalBytes();
+	const int inputVertices = m_meshCtrl->GetVerticesCount();
+
+	// 法線とUVが頂点ごとに一意になるように分離.
+	// 分離後のメッシュ情報と作業領域は、プールから借りて次の出力で再利用する.
+	CMeshScratchPool::CScope scratch(m_param.scratchPool);
+	COutputMeshInfo& meshInfo = scratch.Get().mesh;
+	if (!m_meshCtrl->CreateOutputMesh(m_faceGroupIndex, meshInfo, &scratch.Get())) return;
+
+	// 以降はメッシュ情報を参照しないため、最後の参照であれば解放する.
+	m_meshCtrl.reset();
+
+	// 画面上で小さく表示される場合は簡略化.
+	if (m_param.lod.IsEnabled() && !m_param.subdivisionMesh) {
+		CMeshLOD lod(m_param.lod);
+		lod.Run(meshInfo);
+	}
+
+	if (!m_param.archive || !m_WriteArchive(writer, meshInfo)) {
+		m_WriteGeometry(writer, m_param.indent, meshInfo);
+	}
+
+	if (m_param.profiler) {
+		CExportProfiler::CCounters counters;
+		counters.faces          = meshInfo.GetFacesCount();
+		counters.inputVertices  = inputVertices;
+		counters.outputVertices = (int)meshInfo.vertices.size();
+		counters.bytes          = (writer.GetTotalBytes() - startBytes) + m_archiveBytes;
+		scope.SetCounters(counters);
+	}
+}
+
+bool CMeshOutputJob::IsDone ()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_done;
+}
+
+void CMeshOutputJob::Wait ()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_done) m_condition.wait(lock);
+}
+
+/**
+ * ポリゴンメッシュの形状情報(PointsPolygons/SubdivisionMesh)を出力.
+ */
+void CMeshOutputJob::m_WriteGeometry (CRIBWriter& writer, int indent, const COutputMeshInfo& meshInfo)
+{
+	const int polygonsCou = meshInfo.GetFacesCount();
+	const int verCou      = meshInfo.vertices.size();
+
+	writer.BeginLine(indent);
+	if (m_param.subdivisionMesh) {
+		// catmull-clark での滑らかな曲線.
+		writer.WriteRequest("SubdivisionMesh");
+		writer.WriteString("catmull-clark", true);
+	} else {
+		writer.WriteRequest("PointsPolygons");
+	}
+	writer.EndLine();
+	indent++;
+
+	// 配列は一定サイズごとに分割して出力し、全体のコピーを作らない.
+	int intBuff[RIB_MESH_OUTPUT_CHUNK_SIZE];
+	float floatBuff[RIB_MESH_OUTPUT_CHUNK_SIZE];
+
+	// 面の頂点数を格納.
+	writer.BeginLine(indent);
+	writer.BeginIntArray();
+	for (int i = 0, cou = 0; i < polygonsCou; i++) {
+		intBuff[cou++] = meshInfo.GetFaceVerticesCount(i);
+		if (cou == RIB_MESH_OUTPUT_CHUNK_SIZE || i + 1 == polygonsCou) {
+			writer.AppendIntArray(intBuff, cou);
+			cou = 0;
+		}
+	}
+	writer.EndArray();
+	writer.EndLine();
+
+	// 面のインデックスリストの格納.
+	writer.BeginLine(indent);
+	writer.BeginIntArray();
+	{
+		int cou = 0;
+		for (int i = 0; i < polygonsCou; i++) {
+			const int* indices = meshInfo.GetFaceIndices(i);
+			const int vCou     = meshInfo.GetFaceVerticesCount(i);
+			for (int j = 0; j < vCou; ++j) {
+				intBuff[cou++] = indices[vCou - j - 1];		// 座標系が逆向きになるため、頂点の並びも逆にする.
+				if (cou == RIB_MESH_OUTPUT_CHUNK_SIZE) {
+					writer.AppendIntArray(intBuff, cou);
+					cou = 0;
+				}
+			}
+		}
+		if (cou > 0) writer.AppendIntArray(intBuff, cou);
+	}
+	writer.EndArray();
+	writer.EndLine();
+
+	if (m_param.subdivisionMesh) {
+		// catmull-clark 時に、エッジはSubdivisionせずに保持.
+		const int intArgs[2] = {0, 0};
+		writer.BeginLine(indent);
+		writer.WriteStringArray(std::vector<std::string>(1, "interpolateboundary"), true);
+		writer.WriteIntArray(intArgs, 2);		// nargs (intargs/floatargsの数).
+		writer.WriteIntArray(NULL, 0);			// intargs.
+		writer.WriteFloatArray(NULL, 0);		// floatargs.
+		writer.EndLine();
+	}
+
+	// 頂点座標の格納 (座標系が逆向きになるため、Zを反転).
+	writer.BeginLine(indent);
+	writer.WriteString("P", true);
+	m_WriteVec3Array(writer, meshInfo.vertices, m_param.pointPrecision, floatBuff);
+	writer.EndLine();
+
+	// 法線の格納.
+	if (m_param.outputNormals) {
+		writer.BeginLine(indent);
+		if (meshInfo.normalIndices.empty()) {
+			writer.WriteString("N", true);
+			m_WriteVec3Array(writer, meshInfo.normals, m_param.normalPrecision, floatBuff);
+		} else {
+			writer.WriteString("facevarying normal N", true);
+			m_WriteFacevaryingArray(writer, meshInfo, &(meshInfo.normals[0].x), 3, meshInfo.normalIndices, m_param.normalPrecision, floatBuff);
+		}
+		writer.EndLine();
+	}
+
+	// UVの格納.
+	writer.BeginLine(indent);
+	if (meshInfo.uvIndices.empty()) {
+		writer.WriteString("st", true);
+		writer.BeginFloatArray(verCou * 2);
+		for (int i = 0, cou = 0; i < verCou; i++) {
+			floatBuff[cou++] = meshInfo.uvs[i].x;
+			floatBuff[cou++] = meshInfo.uvs[i].y;
+			if (cou + 2 > RIB_MESH_OUTPUT_CHUNK_SIZE || i + 1 == verCou) {
+				writer.AppendFloatArray(floatBuff, cou, m_param.uvPrecision);
+				cou = 0;
+			}
+		}
+		writer.EndArray();
+	} else {
+		writer.WriteString("facevarying float[2] st", true);
+		m_WriteFacevaryingArray(writer, meshInfo, &(meshInfo.uvs[0].x), 2, meshInfo.uvIndices, m_param.uvPrecision, floatBuff);
+	}
+	writer.EndLine();
+}
+
+/**
+ * 面の頂点ごとの値(facevarying)を、共有している値の番号から展開して分割して出力.
+ * 面の頂点の並びは逆にし、3要素の場合はZを反転する.
+ * @param[in] values      値の配列の先頭 (valueSize個のfloatを1つの値とする).
+ * @param[in] valueIndices  面の頂点ごとの値の番号.
+ * @param[in] buff        RIB_MESH_OUTPUT_CHUNK_SIZE要素の作業バッファ.
+ */
+void CMeshOutputJob::m_WriteFacevaryingArray (CRIBWriter& writer, const COutputMeshInfo& meshInfo, const float* values, const int valueSize, const std::vector<int>& valueIndices, const CRIBFloatPrecision& precision, float* buff)
+{
+	const int polygonsCou = meshInfo.GetFacesCount();
+	writer.BeginFloatArray((int)valueIndices.size() * valueSize);
+	int bCou = 0;
+	for (int i = 0; i < polygonsCou; i++) {
+		const int* indices = &valueIndices[ meshInfo.faceOffsets[i] ];
+		const int vCou     = meshInfo.GetFaceVerticesCount(i);
+		for (int j = 0; j < vCou; ++j) {
+			const float* v = values + (size_t)indices[vCou - j - 1] * valueSize;
+			for (int k = 0; k < valueSize; ++k) buff[bCou++] = v[k];
+			if (valueSize == 3) buff[bCou - 1] = -buff[bCou - 1];
+			if (bCou + valueSize > RIB_MESH_OUTPUT_CHUNK_SIZE) {
+				writer.AppendFloatArray(buff, bCou, precision);
+				bCou = 0;
+			}
+		}
+	}
+	if (bCou > 0) writer.AppendFloatArray(buff, bCou, precision);
+	writer.EndArray();
+}
+
+/**
+ * ベクトルの配列を、Zを反転して分割して出力.
+ * @param[in] buff  RIB_MESH_OUTPUT_CHUNK_SIZE要素の作業バッファ.
+ */
+void CMeshOutputJob::m_WriteVec3Array (CRIBWriter& writer, const std::vector<sxsdk::vec3>& values, const CRIBFloatPrecision& precision, float* buff)
+{
+	const int cou = (int)values.size();
+	writer.BeginFloatArray(cou * 3);
+	for (int i = 0, bCou = 0; i < cou; i++) {
+		const sxsdk::vec3& v = values[i];
+		buff[bCou++] =  v.x;
+		buff[bCou++] =  v.y;
+		buff[bCou++] = -v.z;
+		if (bCou + 3 > RIB_MESH_OUTPUT_CHUNK_SIZE || i + 1 == cou) {
+			writer.AppendFloatArray(buff, bCou, precision);
+			bCou = 0;
+		}
+	}
+	writer.EndArray();
+}
+
+/**
+ * ポリゴンメッシュの形状情報をアーカイブファイルに出力し、DelayedReadArchiveで参照.
+ * レンダラはバウンディングボックスにレイが当たった時点でアーカイブを読み込む.
+ */
+bool CMeshOutputJob::m_WriteArchive (CRIBWriter& writer, const COutputMeshInfo& meshInfo)
+{
+	const std::string& fileName = m_param.archiveFileName;
+
+	// アーカイブの内容のハッシュ値を計算.
+	// 出力オプションと頂点/面情報が前回のエクスポートと同じ場合は、前回のアーカイブファイルをそのまま使用する.
+	unsigned long long hash = 0;
+	{
+		CHashCalc hashCalc;
+		hashCalc.Append(RIB_GEOMETRY_ARCHIVE_VERSION);
+		hashCalc.Append((int)m_param.encoding);
+		hashCalc.Append(m_param.compress ? 1 : 0);
+		hashCalc.Append(m_param.subdivisionMesh ? 1 : 0);
+		hashCalc.Append(m_param.outputNormals ? 1 : 0);
+		const CRIBFloatPrecision* precisions[3] = { &m_param.pointPrecision, &m_param.normalPrecision, &m_param.uvPrecision };
+		for (int i = 0; i < 3; ++i) {
+			hashCalc.Append(precisions[i]->significantDigits);
+			hashCalc.Append(precisions[i]->decimals);
+			hashCalc.Append(&(precisions[i]->grid), sizeof(float));
+		}
+		hashCalc.Append(meshInfo.vertices);
+		hashCalc.Append(meshInfo.normals);
+		hashCalc.Append(meshInfo.uvs);
+		for (int i = 0; i < meshInfo.GetFacesCount(); i++) {
+			// 面ごとに頂点数と頂点インデックスを加える (面ごとの配列で保持していた際と同じハッシュ値になる).
+			const int vCou = meshInfo.GetFaceVerticesCount(i);
+			hashCalc.Append(vCou);
+			hashCalc.Append(meshInfo.GetFaceIndices(i), sizeof(int) * vCou);
+		}
+		if (!meshInfo.normalIndices.empty() || !meshInfo.uvIndices.empty()) {
+			hashCalc.Append(meshInfo.normalIndices);
+			hashCalc.Append(meshInfo.uvIndices);
+		}
+		hash = hashCalc.GetHash();
+	}
+
+	const bool reused = m_param.cache && m_param.reuseCache && m_param.cache->IsValid(fileName, hash);
+	if (!reused) {
+		// 途中で中断された場合に不完全なファイルが残らないように、一時ファイルに出力後に置き換える.
+		const std::string archiveFilePath = m_param.archivePath + "/" + fileName;
+		const std::string tempFilePath    = archiveFilePath + ".tmp";
+		{
+			CRIBWriter archiveWriter(NULL, m_param.encoding);
+			if (!archiveWriter.Open(tempFilePath, m_param.compress)) return false;
+			archiveWriter.WriteLine(0, "##RenderMan RIB");
+			m_WriteGeometry(archiveWriter, 0, meshInfo);
+			m_archiveBytes = archiveWriter.GetTotalBytes();
+			if (!archiveWriter.Close()) {
+				// 書き込みに失敗した場合は、不完全なファイルを残さずにエラーとする.
+				remove(tempFilePath.c_str());
+				throw std::runtime_error("failed to write " + fileName);
+			}
+		}
+		remove(archiveFilePath.c_str());
+		if (rename(tempFilePath.c_str(), archiveFilePath.c_str()) != 0) {
+			remove(tempFilePath.c_str());
+			return false;
+		}
+	}
+	if (m_param.cache) m_param.cache->Set(fileName, hash, reused);
+
+	// ワールド座標でのバウンディングボックス (xmin xmax ymin ymax zmin zmax).
+	float bounds[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+	const std::vector<sxsdk::vec3>& vertices = meshInfo.vertices;
+	if (!vertices.empty()) {
+		sxsdk::vec3 bbMin = vertices[0];
+		sxsdk::vec3 bbMax = vertices[0];
+		for (size_t i = 1; i < vertices.size(); ++i) {
+			const sxsdk::vec3& v = vertices[i];
+			bbMin.x = std::min(bbMin.x, v.x);
+			bbMin.y = std::min(bbMin.y, v.y);
+			bbMin.z = std::min(bbMin.z, v.z);
+			bbMax.x = std::max(bbMax.x, v.x);
+			bbMax.y = std::max(bbMax.y, v.y);
+			bbMax.z = std::max(bbMax.z, v.z);
+		}
+		bounds[0] =  bbMin.x;
+		bounds[1] =  bbMax.x;
+		bounds[2] =  bbMin.y;
+		bounds[3] =  bbMax.y;
+		bounds[4] = -bbMax.z;		// 座標系が逆向きになるため、Zを反転.
+		bounds[5] = -bbMin.z;
+	}
+
+	writer.BeginLine(m_param.indent);
+	writer.WriteRequest("Procedural");
+	writer.WriteString("DelayedReadArchive", true);
+	writer.WriteStringArray(std::vector<std::string>(1, fileName));
+	writer.WriteFloatArray(bounds, 6);
+	writer.EndLine();
+
+	return true;
+}
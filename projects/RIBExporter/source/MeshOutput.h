@@ -0,0 +1,130 @@
+﻿/**
+ * ポリゴンメッシュの出力処理.
+ * faceGroupごとの頂点の分離と、RIBへの変換(ASCII/バイナリ)を行う.
+ * Shade3DのSDKを呼ばないため、ワーカースレッドで実行できる.
+ */
+
+#ifndef _MESHOUTPUT_H
+#define _MESHOUTPUT_H
+
+#include "GlobalHeader.h"
+#include "PolygonMeshCtrl.h"
+#include "RIBWriter.h"
+#include "GeometryCache.h"
+#include "ExportProfiler.h"
+#include "MeshLOD.h"
+#include "MeshScratch.h"
+
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * ポリゴンメッシュの出力パラメータ.
+ */
+class CMeshOutputParam
+{
+public:
+	RIBParam::RIB_ENCODING_TYPE encoding;		// RIBの出力形式.
+	int indent;									// インデントの深さ.
+	bool subdivisionMesh;						// SubdivisionMesh(catmull-clark)として出力する場合はtrue.
+	bool outputNormals;							// 法線を出力する場合はtrue.
+
+	CRIBFloatPrecision pointPrecision;			// 頂点座標(P)の出力精度.
+	CRIBFloatPrecision normalPrecision;			// 法線(N)の出力精度.
+	CRIBFloatPrecision uvPrecision;				// UV(st)の出力精度.
+	CMeshLODParam lod;							// 画面上の大きさに応じた簡略化 (SubdivisionMeshの場合は行わない).
+
+	bool archive;								// アーカイブファイルに出力してDelayedReadArchiveで参照する場合はtrue.
+	bool compress;								// アーカイブファイルをgzip圧縮する場合はtrue.
+	std::string archivePath;					// アーカイブファイルの基準となるパス (RIBファイルの保存パス).
+	std::string archiveFileName;				// アーカイブファイル名 (geometry/xxx.rib).
+	CGeometryArchiveCache* cache;				// アーカイブのキャッシュ情報 (出力したアーカイブのハッシュ値を登録する).
+	bool reuseCache;							// 内容が変わっていない場合に、前回のアーカイブファイルを再利用する場合はtrue.
+
+	std::string name;							// 形状名 (計測結果の表示用).
+	int shapeID;								// 形状の通し番号 (計測結果を形状ごとに集計する).
+	CExportProfiler* profiler;					// 処理の計測 (NULLの場合は計測しない).
+	CMeshScratchPool* scratchPool;				// 頂点の分離で使用する作業領域のプール (NULLの場合は出力ごとに確保).
+
+public:
+	CMeshOutputParam () {
+		encoding        = RIBParam::rib_ascii;
+		indent          = 0;
+		subdivisionMesh = false;
+		outputNormals   = true;
+		archive         = false;
+		compress        = false;
+		cache           = NULL;
+		reuseCache      = false;
+		shapeID         = -1;
+		profiler        = NULL;
+		scratchPool     = NULL;
+	}
+};
+
+/**
+ * faceGroup単位のポリゴンメッシュの出力処理.
+ */
+class CMeshOutputJob : public CRIBDeferredOutput
+{
+private:
+	std::shared_ptr<const CPolygonMeshCtrl> m_meshCtrl;		// 格納済みのポリゴンメッシュ情報.
+	int m_faceGroupIndex;									// 出力するfaceGroup番号.
+	CMeshOutputParam m_param;								// 出力パラメータ.
+
+	std::vector<char> m_output;								// 出力結果.
+	size_t m_archiveBytes;									// アーカイブファイルに出力したバイト数.
+	bool m_done;											// 処理が完了している場合はtrue.
+	std::string m_error;									// 処理中に例外が発生した場合のエラー内容 (成功した場合は空).
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+
+	/**
+	 * 頂点の分離、簡略化を行い、指定の出力先に出力.
+	 */
+	void m_Write (CRIBWriter& writer);
+
+	/**
+	 * ポリゴンメッシュの形状情報(PointsPolygons/SubdivisionMesh)を出力.
+	 */
+	void m_WriteGeometry (CRIBWriter& writer, int indent, const COutputMeshInfo& meshInfo);
+
+	/**
+	 * ポリゴンメッシュの形状情報をアーカイブファイルに出力し、DelayedReadArchiveで参照.
+	 * @return アーカイブファイルを作成できなかった場合はfalse.
+	 */
+	bool m_WriteArchive (CRIBWriter& writer, const COutputMeshInfo& meshInfo);
+
+	/**
+	 * ベクトルの配列を、Zを反転して分割して出力.
+	 */
+	void m_WriteVec3Array (CRIBWriter& writer, const std::vector<sxsdk::vec3>& values, const CRIBFloatPrecision& precision, float* buff);
+
+	/**
+	 * 面の頂点ごとの値(facevarying)を展開して出力.
+	 */
+	void m_WriteFacevaryingArray (CRIBWriter& writer, const COutputMeshInfo& meshInfo, const float* values, const int valueSize, const std::vector<int>& valueIndices, const CRIBFloatPrecision& precision, float* buff);
+
+public:
+	CMeshOutputJob (const std::shared_ptr<const CPolygonMeshCtrl>& meshCtrl, const int faceGroupIndex, const CMeshOutputParam& param);
+
+	/**
+	 * 出力処理を実行.
+	 * 出力内容はメモリ上に保持し、GetOutputで取得する.
+	 */
+	void Run ();
+
+	/**
+	 * 出力処理を実行し、指定の出力先に直接出力.
+	 * 例外は外に投げず、エラー内容をGetErrorで取得できるようにする.
+	 * @return 失敗した場合はfalse.
+	 */
+	bool Write (CRIBWriter& writer);
+
+	virtual bool IsDone ();
+	virtual void Wait ();
+	virtual const std::vector<char>& GetOutput () const { return m_output; }
+	virtual std::string GetError () const { return m_error; }
+};
+
+#endif
@@ -0,0 +1,216 @@
+﻿/**
+ * ポリゴンメッシュの出力処理で使用する作業領域.
+ */
+
+#include "MeshScratch.h"
+
+#include <algorithm>
+
+namespace {
+	/**
+	 * CWeldKeyのハッシュ値.
+	 */
+	inline size_t HashWeldKey (const CWeldKey& k) {
+		unsigned long long h = (unsigned long long)(unsigned int)k.orgIndex * 0x9e3779b97f4a7c15ULL;
+		for (int i = 0; i < 5; ++i) {
+			h ^= (unsigned long long)k.values[i] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+		}
+		return (size_t)(h ^ (h >> 32));
+	}
+}
+
+//-----------------------------------------------------------.
+
+CWeldTable::CWeldTable ()
+{
+	m_stamp = 1;
+	m_mask  = 0;
+	m_count = 0;
+}
+
+/**
+ * スロット数を指定数以上に増やし、格納済みの要素を入れ直す.
+ */
+void CWeldTable::m_Grow (const size_t slotCount)
+{
+	size_t newSlotCou = 16;
+	while (newSlotCou < slotCount) newSlotCou <<= 1;
+	if (newSlotCou <= m_stamps.size()) return;
+
+	std::vector<CWeldKey> keys;
+	std::vector<int> values;
+	std::vector<unsigned int> stamps;
+	keys.swap(m_keys);
+	values.swap(m_values);
+	stamps.swap(m_stamps);
+	const unsigned int oldStamp = m_stamp;
+
+	m_keys.resize(newSlotCou);
+	m_values.resize(newSlotCou);
+	m_stamps.assign(newSlotCou, 0);
+	m_stamp = 1;
+	m_mask  = newSlotCou - 1;
+	m_count = 0;
+	for (size_t i = 0; i < stamps.size(); ++i) {
+		if (stamps[i] == oldStamp) Set(keys[i], values[i]);
+	}
+}
+
+/**
+ * 空にする.
+ * 世代番号を進めるだけのため、スロットが足りている場合はO(1).
+ */
+void CWeldTable::Reset (const size_t expectedCount)
+{
+	m_count = 0;
+	if (++m_stamp == 0) {
+		// 世代番号が一周した場合は、すべてのスロットを未使用にする.
+		std::fill(m_stamps.begin(), m_stamps.end(), 0);
+		m_stamp = 1;
+	}
+	if (expectedCount * 2 > m_stamps.size()) m_Grow(expectedCount * 2);
+}
+
+/**
+ * キーを検索し、ない場合は指定の番号で追加.
+ */
+int CWeldTable::Insert (const CWeldKey& key, const int value, bool& retInserted)
+{
+	// 使用率が1/2を超える場合はスロットを増やす.
+	if ((m_count + 1) * 2 > m_stamps.size()) m_Grow((m_count + 1) * 2);
+
+	for (size_t i = HashWeldKey(key) & m_mask; ; i = (i + 1) & m_mask) {
+		if (m_stamps[i] != m_stamp) {
+			m_stamps[i] = m_stamp;
+			m_keys[i]   = key;
+			m_values[i] = value;
+			m_count++;
+			retInserted = true;
+			return value;
+		}
+		if (m_keys[i] == key) {
+			retInserted = false;
+			return m_values[i];
+		}
+	}
+}
+
+/**
+ * キーに対応する番号を設定 (ない場合は追加).
+ */
+void CWeldTable::Set (const CWeldKey& key, const int value)
+{
+	if ((m_count + 1) * 2 > m_stamps.size()) m_Grow((m_count + 1) * 2);
+
+	for (size_t i = HashWeldKey(key) & m_mask; ; i = (i + 1) & m_mask) {
+		if (m_stamps[i] != m_stamp) {
+			m_stamps[i] = m_stamp;
+			m_keys[i]   = key;
+			m_values[i] = value;
+			m_count++;
+			return;
+		}
+		if (m_keys[i] == key) {
+			m_values[i] = value;
+			return;
+		}
+	}
+}
+
+/**
+ * キーを検索.
+ */
+int CWeldTable::Find (const CWeldKey& key) const
+{
+	if (m_count == 0) return -1;
+
+	for (size_t i = HashWeldKey(key) & m_mask; ; i = (i + 1) & m_mask) {
+		if (m_stamps[i] != m_stamp) return -1;
+		if (m_keys[i] == key) return m_values[i];
+	}
+}
+
+//-----------------------------------------------------------.
+
+/**
+ * 確保済みの領域のバイト数を取得.
+ */
+size_t CMeshScratch::GetCapacityBytes () const
+{
+	size_t bytes = mesh.GetCapacityBytes();
+	bytes += (vertexMap.capacity() + usedVertices.capacity() + vertexNormals.capacity() + vertexUVs.capacity() + nextCopy.capacity() + copyCounts.capacity()) * sizeof(int);
+	bytes += usedList.capacity() + normals.capacity() * sizeof(sxsdk::vec3) + uvs.capacity() * sizeof(sxsdk::vec2);
+	bytes += weldTable.GetCapacityBytes() + normalTable.GetCapacityBytes() + uvTable.GetCapacityBytes();
+	return bytes;
+}
+
+//-----------------------------------------------------------.
+
+CMeshScratchPool::CMeshScratchPool ()
+{
+}
+
+CMeshScratchPool::~CMeshScratchPool ()
+{
+	Clear();
+}
+
+/**
+ * 使用中でない作業領域を取得 (ない場合は確保).
+ */
+CMeshScratch* CMeshScratchPool::Acquire ()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_freeList.empty()) {
+		CMeshScratch* scratch = m_freeList.back();
+		m_freeList.pop_back();
+		return scratch;
+	}
+	CMeshScratch* scratch = new CMeshScratch();
+	m_scratches.push_back(scratch);
+	m_freeList.reserve(m_scratches.size());
+	return scratch;
+}
+
+/**
+ * 作業領域を返却.
+ * 大きなメッシュで使用した作業領域を保持し続けないように、上限を超える場合は解放する.
+ */
+void CMeshScratchPool::Release (CMeshScratch* scratch)
+{
+	if (!scratch) return;
+	const size_t bytes = scratch->GetCapacityBytes();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_freeList.size() < MESH_POOL_MAX_COUNT && bytes <= MESH_POOL_MAX_BYTES) {
+		m_freeList.push_back(scratch);
+		return;
+	}
+	std::vector<CMeshScratch*>::iterator iter = std::find(m_scratches.begin(), m_scratches.end(), scratch);
+	if (iter != m_scratches.end()) m_scratches.erase(iter);
+	delete scratch;
+}
+
+/**
+ * すべての作業領域を解放.
+ */
+void CMeshScratchPool::Clear ()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_scratches.size(); ++i) delete m_scratches[i];
+	m_scratches.clear();
+	m_freeList.clear();
+}
+
+//-----------------------------------------------------------.
+
+CMeshScratchPool::CScope::CScope (CMeshScratchPool* pool) : m_pool(pool)
+{
+	m_scratch = m_pool ? m_pool->Acquire() : new CMeshScratch();
+}
+
+CMeshScratchPool::CScope::~CScope ()
+{
+	if (m_pool) m_pool->Release(m_scratch);
+	else delete m_scratch;
+}
@@ -0,0 +1,166 @@
+﻿/**
+ * ポリゴンメッシュの出力処理で使用する作業領域.
+ * 形状ごとに確保/解放を繰り返さないように、確保済みの領域をエクスポート中に再利用する.
+ */
+
+#ifndef _MESHSCRATCH_H
+#define _MESHSCRATCH_H
+
+#include "GlobalHeader.h"
+#include "PolygonMeshCtrl.h"
+
+#include <mutex>
+
+/**
+ * 頂点の分離時に、同一とみなす頂点を検索するためのキー.
+ */
+class CWeldKey
+{
+public:
+	int orgIndex;				// 元の頂点番号.
+	long long values[5];		// 量子化した法線(xyz)とUV(xy).
+
+	bool operator == (const CWeldKey& k) const {
+		return (orgIndex == k.orgIndex && values[0] == k.values[0] && values[1] == k.values[1] && values[2] == k.values[2] && values[3] == k.values[3] && values[4] == k.values[4]);
+	}
+};
+
+/**
+ * CWeldKeyから番号を検索するハッシュテーブル (オープンアドレス法).
+ * 要素ごとのメモリ確保を行わず、Resetは使用中の印(世代番号)を進めるだけのため、
+ * 確保済みの領域を次のメッシュでそのまま使用できる.
+ */
+class CWeldTable
+{
+private:
+	std::vector<CWeldKey> m_keys;
+	std::vector<int> m_values;
+	std::vector<unsigned int> m_stamps;		// スロットごとの世代番号 (m_stampと同じ場合は使用中).
+	unsigned int m_stamp;					// 現在の世代番号.
+	size_t m_mask;							// スロット数 - 1 (スロット数は2のべき乗).
+	size_t m_count;							// 格納数.
+
+	/**
+	 * スロット数を指定数以上に増やし、格納済みの要素を入れ直す.
+	 */
+	void m_Grow (const size_t slotCount);
+
+public:
+	CWeldTable ();
+
+	/**
+	 * 空にする.
+	 * @param[in] expectedCount  格納する要素数の目安 (スロットが不足する場合のみ確保する).
+	 */
+	void Reset (const size_t expectedCount = 0);
+
+	/**
+	 * キーを検索し、ない場合は指定の番号で追加.
+	 * @param[out] retInserted  追加した場合はtrue.
+	 * @return キーに対応する番号.
+	 */
+	int Insert (const CWeldKey& key, const int value, bool& retInserted);
+
+	/**
+	 * キーに対応する番号を設定 (ない場合は追加).
+	 */
+	void Set (const CWeldKey& key, const int value);
+
+	/**
+	 * キーを検索.
+	 * @return キーに対応する番号 (ない場合は-1).
+	 */
+	int Find (const CWeldKey& key) const;
+
+	/**
+	 * 確保済みの領域のバイト数を取得.
+	 */
+	size_t GetCapacityBytes () const { return m_keys.capacity() * sizeof(CWeldKey) + (m_values.capacity() + m_stamps.capacity()) * sizeof(int); }
+};
+
+/**
+ * 頂点の分離で使用する作業領域.
+ * 1つの作業領域を、複数のスレッドで同時に使用しないこと.
+ */
+class CMeshScratch
+{
+public:
+	COutputMeshInfo mesh;						// 出力用のポリゴンメッシュ情報.
+
+	std::vector<int> vertexMap;					// 元の頂点番号ごとの、出力する頂点番号.
+	std::vector<int> usedVertices;				// 使用している元の頂点番号 (ソート済み).
+	std::vector<int> vertexNormals;				// facevaryingの場合の、頂点ごとに最初に参照された法線番号.
+	std::vector<int> vertexUVs;					// facevaryingの場合の、頂点ごとに最初に参照されたUV番号.
+	std::vector<char> usedList;					// 出力する頂点を参照済みの場合は1.
+	std::vector<int> nextCopy;					// 同じ元の頂点から分離した次の頂点番号 (ない場合は-1).
+	std::vector<int> copyCounts;				// 元の頂点ごとの、分離した頂点数 (最初の頂点を含む).
+	std::vector<sxsdk::vec3> normals;			// 頂点ごとの法線に並べ直す際の作業用.
+	std::vector<sxsdk::vec2> uvs;				// 頂点ごとのUVに並べ直す際の作業用.
+
+	CWeldTable weldTable;						// 元の頂点番号と法線/UVから、分離後の頂点番号を検索.
+	CWeldTable normalTable;						// facevaryingの場合の、法線から法線番号を検索.
+	CWeldTable uvTable;							// facevaryingの場合の、UVからUV番号を検索.
+
+	/**
+	 * 確保済みの領域のバイト数を取得.
+	 */
+	size_t GetCapacityBytes () const;
+};
+
+/**
+ * 作業領域のプール.
+ * エクスポート中に保持し、ワーカースレッドごとに使用中でない作業領域を貸し出す.
+ * 返却時に、保持数がMESH_POOL_MAX_COUNTに達している場合や確保済みの領域がMESH_POOL_MAX_BYTESを超える場合は解放する.
+ */
+class CMeshScratchPool
+{
+private:
+	std::vector<CMeshScratch*> m_scratches;		// 確保したすべての作業領域.
+	std::vector<CMeshScratch*> m_freeList;		// 使用中でない作業領域.
+	std::mutex m_mutex;
+
+	CMeshScratchPool (const CMeshScratchPool&);
+	CMeshScratchPool& operator = (const CMeshScratchPool&);
+
+public:
+	/**
+	 * スコープの間、作業領域を借りる.
+	 * poolがNULLの場合は、スコープ内だけの作業領域を使用する.
+	 */
+	class CScope
+	{
+	private:
+		CMeshScratchPool* m_pool;
+		CMeshScratch* m_scratch;
+
+		CScope (const CScope&);
+		CScope& operator = (const CScope&);
+
+	public:
+		CScope (CMeshScratchPool* pool);
+		~CScope ();
+
+		CMeshScratch& Get () { return *m_scratch; }
+	};
+
+public:
+	CMeshScratchPool ();
+	~CMeshScratchPool ();
+
+	/**
+	 * 使用中でない作業領域を取得 (ない場合は確保).
+	 */
+	CMeshScratch* Acquire ();
+
+	/**
+	 * 作業領域を返却.
+	 */
+	void Release (CMeshScratch* scratch);
+
+	/**
+	 * すべての作業領域を解放 (使用中の作業領域がないときに呼ぶこと).
+	 */
+	void Clear ();
+};
+
+#endif
@@ -5,7 +5,114 @@
 
 #include "PolygonMeshCtrl.h"
 #include <cmath>
+#include <string.h>
+#include <algorithm>
 #include "Util.h"
+#include "MathUtil.h"
+#include "MeshScratch.h"
+
+namespace {
+	/**
+	 * 溶接の許容値の間隔で値を量子化.
+	 * 許容値が0の場合は、値が完全に一致する場合のみ同一とする.
+	 */
+	inline long long QuantizeWeldValue (const float v, const float invTolerance) {
+		if (invTolerance <= 0.0f) {
+			if (v == 0.0f) return 0;		// -0と+0を同一とする.
+			int iv;
+			memcpy(&iv, &v, sizeof(float));
+			return iv;
+		}
+		return (long long)std::floor((double)v * (double)invTolerance + 0.5);
+	}
+
+	/**
+	 * 2つの値が、各要素で許容値以内か.
+	 */
+	inline bool IsWeldNear (const sxsdk::vec3& a, const sxsdk::vec3& b, const float tolerance) {
+		return (std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance);
+	}
+	inline bool IsWeldNear (const sxsdk::vec2& a, const sxsdk::vec2& b, const float tolerance) {
+		return (std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance);
+	}
+
+	/**
+	 * 量子化したキーの隣接するセルから、許容値以内の登録済みの値を検索.
+	 * 許容値以内の値でも量子化したセルの境界をまたぐ場合があるため、各軸で前後のセルを調べ、isNearで比較する.
+	 * セルの幅は許容値のため、1つのセルに登録される値は1つだけとなる.
+	 * @param[in] dims    調べるキーの要素番号.
+	 * @param[in] dimCou  dimsの数.
+	 * @param[in] isNear  登録済みの番号を受け取り、許容値以内の場合はtrueを返す.
+	 * @return 見つからない場合は-1.
+	 */
+	template<class C> int FindWeldNeighbor (const CWeldTable& table, const CWeldKey& key, const int* dims, const int dimCou, const C& isNear) {
+		int cellCou = 1;
+		for (int i = 0; i < dimCou; i++) cellCou *= 3;
+
+		CWeldKey nKey = key;
+		for (int cell = 0; cell < cellCou; cell++) {
+			bool center = true;
+			for (int i = 0, c = cell; i < dimCou; i++, c /= 3) {
+				const int d = (c % 3) - 1;
+				nKey.values[ dims[i] ] = key.values[ dims[i] ] + d;
+				if (d != 0) center = false;
+			}
+			if (center) continue;
+
+			const int nIndex = table.Find(nKey);
+			if (nIndex >= 0 && isNear(nIndex)) return nIndex;
+		}
+		return -1;
+	}
+
+	/**
+	 * 登録済みの値と比較 (facevaryingの法線/UV).
+	 */
+	template<class T> class CWeldValueNear
+	{
+	public:
+		const std::vector<T>& values;
+		const T& value;
+		const float tolerance;
+
+		CWeldValueNear (const std::vector<T>& values, const T& value, const float tolerance) : values(values), value(value), tolerance(tolerance) { }
+		bool operator () (const int index) const { return IsWeldNear(values[index], value, tolerance); }
+	};
+
+	/**
+	 * 分離済みの頂点の法線/UVと比較.
+	 */
+	class CWeldVertexNear
+	{
+	public:
+		const COutputMeshInfo& meshInfo;
+		const sxsdk::vec3& normal;
+		const sxsdk::vec2& uv;
+		const bool compareNormal;
+		const bool compareUV;
+		const float tolerance;
+
+		CWeldVertexNear (const COutputMeshInfo& meshInfo, const sxsdk::vec3& normal, const sxsdk::vec2& uv, const bool compareNormal, const bool compareUV, const float tolerance)
+			: meshInfo(meshInfo), normal(normal), uv(uv), compareNormal(compareNormal), compareUV(compareUV), tolerance(tolerance) { }
+		bool operator () (const int index) const {
+			return (!compareNormal || IsWeldNear(meshInfo.normals[index], normal, tolerance)) && (!compareUV || IsWeldNear(meshInfo.uvs[index], uv, tolerance));
+		}
+	};
+
+	/**
+	 * 量子化したキーで、許容値以内の登録済みの値を検索 (facevaryingの法線/UV).
+	 * 同じセルにない場合は、隣接するセルも調べる.
+	 * @param[in] dims  キーの要素数 (法線は3、UVは2).
+	 * @return 見つからない場合は-1.
+	 */
+	template<class T> int FindWeldValue (const CWeldTable& table, const CWeldKey& key, const int dims, const T& value, const std::vector<T>& values, const float tolerance) {
+		const int index = table.Find(key);
+		if (index >= 0 || tolerance <= 0.0f) return index;
+
+		static const int dimIndices[3] = {0, 1, 2};
+		return FindWeldNeighbor(table, key, dimIndices, dims, CWeldValueNear<T>(values, value, tolerance));
+	}
+}
 
 CPolygonMeshCtrl::CPolygonMeshCtrl (sxsdk::shade_interface& shade): shade(shade)
 {
@@ -19,287 +126,506 @@ void CPolygonMeshCtrl::Clear ()
 {
 	m_name = "";
 	m_vertices.clear();
-	m_polygons.clear();
+	m_transform    = sxsdk::mat4::identity;
+	m_hasTransform = false;
+	m_transformed  = false;
+	m_faceOffsets.assign(1, 0);
+	m_faceIndices.clear();
+	m_faceNormals.clear();
+	m_faceUVs.clear();
+	m_faceGroupIndices.clear();
 
 	m_currentFaceGroupIndex = -1;
 	m_faceGroupCount = 0;
+	m_weldTolerance = MESH_WELD_TOLERANCE;
+	m_facevarying   = false;
+	m_triangulateNonConvex = true;
+
+	m_faceGroupOffsets.clear();
+	m_faceGroupFaces.clear();
 }
 
 /**
  * 格納開始.
  */
-void CPolygonMeshCtrl::BeginStore (const std::string name, const bool separateUV, const bool separateNormal)
+void CPolygonMeshCtrl::BeginStore (const std::string name, const bool separateUV, const bool separateNormal, const float weldTolerance, const bool facevarying)
 {
 	Clear();
 	m_separateUV     = separateUV;
 	m_separateNormal = separateNormal;
+	m_weldTolerance  = weldTolerance;
+	m_facevarying    = facevarying;
 
 	m_name = Util::ReplaceName(name);
 }
 
 /**
- * 格納終了.
+ * faceGroupごとの面番号リストを作成.
+ * 面を1回走査してfaceGroupごとの面数を数え、計数ソートで面番号を並べる (faceGroup内では格納順).
+ * faceGroupが連続していない場合も、同じfaceGroupの面はまとめられる.
  */
-void CPolygonMeshCtrl::EndStore ()
+void CPolygonMeshCtrl::BuildFaceGroups ()
 {
-	// faceGroupごとに分解。頂点ごとの法線、UV参照になるようにする.
-	m_Classification();
+	m_ApplyTransform();
+	m_RemoveInvalidPolygons();
+
+	const int faceCou   = (int)m_faceGroupIndices.size();
+	const int bucketCou = m_faceGroupCount + 1;		// faceGroupなし(-1)を先頭とする.
+
+	m_faceGroupOffsets.assign(bucketCou + 1, 0);
+	for (int i = 0; i < faceCou; i++) {
+		m_faceGroupOffsets[m_faceGroupIndices[i] + 2]++;
+	}
+	for (int i = 0; i < bucketCou; i++) {
+		m_faceGroupOffsets[i + 1] += m_faceGroupOffsets[i];
+	}
+
+	m_faceGroupFaces.resize(faceCou);
+	std::vector<int> positions(m_faceGroupOffsets.begin(), m_faceGroupOffsets.end() - 1);
+	for (int i = 0; i < faceCou; i++) {
+		m_faceGroupFaces[ positions[m_faceGroupIndices[i] + 1]++ ] = i;
+	}
 }
 
 /**
- * 頂点座標追加.
+ * 格納した頂点座標/法線をまとめて変換し、法線を正規化.
+ * Shade3Dからの通知ごとに1つずつ変換せず、格納後に配列全体をSIMDで変換する.
  */
-void CPolygonMeshCtrl::AppendVertex (const sxsdk::vec3& v)
+void CPolygonMeshCtrl::m_ApplyTransform ()
 {
-	m_vertices.push_back(v);
+	if (m_transformed) return;
+	m_transformed = true;
+
+	if (m_hasTransform && !m_vertices.empty()) MathUtil::TransformPoints(&m_vertices[0], (int)m_vertices.size(), m_transform);
+	if (!m_faceNormals.empty()) MathUtil::TransformNormals(&m_faceNormals[0], (int)m_faceNormals.size(), m_hasTransform ? m_transform : sxsdk::mat4::identity);
 }
 
 /**
- * 面情報追加.
+ * 面積のない面、NaN/Infの頂点を持つ面を除外.
+ * 頂点をまとめて判定してから、面の情報を詰めて格納し直す.
  */
-void CPolygonMeshCtrl::AppendPolygon (const std::vector<int>& indices, const std::vector<sxsdk::vec3>& normals, const std::vector<sxsdk::vec2>& uvs, const int faceGroupIndex)
+void CPolygonMeshCtrl::m_RemoveInvalidPolygons ()
 {
-	// 面積のない面の場合/NANの頂点を持つ面の場合はスキップ.
-	{
-		const int vCou = (int)indices.size();
-		if (vCou <= 2) return;
-		if (vCou == 3 || vCou == 4) {
-			sxsdk::vec3 versA[4];
-			bool nanF = false;
-			for (int i = 0; i < vCou; i++) {
-				versA[i] = m_vertices[indices[i]];
-				if (std::isnan(versA[i].x) || std::isnan(versA[i].y) || std::isnan(versA[i].z)) {
-					nanF = true;
+	std::vector<char> invalidVertices;
+	const bool hasInvalidVertex = (MathUtil::FindInvalidVertices(m_vertices, invalidVertices) > 0);
+
+	const int faceCou = (int)m_faceGroupIndices.size();
+	int dstFaceCou   = 0;
+	int dstCornerCou = 0;
+	int srcBegin     = 0;
+	for (int i = 0; i < faceCou; i++) {
+		const int srcEnd = m_faceOffsets[i + 1];
+		const int vCou   = srcEnd - srcBegin;
+		const int* indices = &m_faceIndices[srcBegin];
+
+		bool valid = !MathUtil::IsDegeneratePolygon(m_vertices, indices, vCou);
+		if (valid && hasInvalidVertex) {
+			for (int j = 0; j < vCou; j++) {
+				if (invalidVertices[ indices[j] ]) {
+					valid = false;
 					break;
 				}
 			}
-			if (nanF) return;
-
-			{
-				int cou = vCou;
-				for (int i = 0; i < vCou; i++) {
-					const sxsdk::vec3 v = versA[i] - versA[(i + 1) % vCou];
-					if (sx::zero(v)) cou--;
-				}
-				if (cou <= 2) return;
+		}
+		if (valid) {
+			if (dstCornerCou != srcBegin) {
+				std::copy(m_faceIndices.begin() + srcBegin, m_faceIndices.begin() + srcEnd, m_faceIndices.begin() + dstCornerCou);
+				std::copy(m_faceNormals.begin() + srcBegin, m_faceNormals.begin() + srcEnd, m_faceNormals.begin() + dstCornerCou);
+				std::copy(m_faceUVs.begin() + srcBegin, m_faceUVs.begin() + srcEnd, m_faceUVs.begin() + dstCornerCou);
 			}
+			dstCornerCou += vCou;
+			m_faceGroupIndices[dstFaceCou] = m_faceGroupIndices[i];
+			m_faceOffsets[++dstFaceCou] = dstCornerCou;
 		}
+		srcBegin = srcEnd;
 	}
+	if (dstFaceCou == faceCou) return;
 
-	m_polygons.push_back(CMeshPolygon());
-	CMeshPolygon& polygon = m_polygons.back();
+	m_faceOffsets.resize(dstFaceCou + 1);
+	m_faceGroupIndices.resize(dstFaceCou);
+	m_faceIndices.resize(dstCornerCou);
+	m_faceNormals.resize(dstCornerCou);
+	m_faceUVs.resize(dstCornerCou);
+}
 
-	polygon.indices  = indices;
-	polygon.normals  = normals;
-	polygon.uvs      = uvs;
-	polygon.faceGroupIndex = faceGroupIndex;
+/**
+ * 頂点数/面数を指定して、格納領域を確保.
+ * 面の頂点数は不明のため、四角形として確保する.
+ */
+void CPolygonMeshCtrl::ReserveVertices (const int count)
+{
+	if (count > 0) m_vertices.reserve(count);
+}
+
+void CPolygonMeshCtrl::ReservePolygons (const int count)
+{
+	if (count <= 0) return;
+	m_faceOffsets.reserve(count + 1);
+	m_faceGroupIndices.reserve(count);
+	m_faceIndices.reserve((size_t)count * 4);
+	m_faceNormals.reserve((size_t)count * 4);
+	m_faceUVs.reserve((size_t)count * 4);
+}
+
+/**
+ * 頂点座標追加.
+ */
+void CPolygonMeshCtrl::AppendVertex (const sxsdk::vec3& v)
+{
+	m_vertices.push_back(v);
+}
+
+/**
+ * 確保済みの領域のバイト数を取得.
+ */
+size_t CPolygonMeshCtrl::GetCapacityBytes () const
+{
+	size_t bytes = (m_vertices.capacity() + m_faceNormals.capacity()) * sizeof(sxsdk::vec3) + m_faceUVs.capacity() * sizeof(sxsdk::vec2);
+	bytes += (m_faceOffsets.capacity() + m_faceIndices.capacity() + m_faceGroupIndices.capacity()) * sizeof(int);
+	bytes += (m_faceGroupOffsets.capacity() + m_faceGroupFaces.capacity() + m_triangleCorners.capacity() + m_polygonWork.remain.capacity()) * sizeof(int);
+	bytes += (m_polygonWork.pos.capacity() + m_polygonWork.xy.capacity()) * sizeof(double);
+	return bytes;
+}
+
+/**
+ * 格納した頂点のバウンディングボックスを取得.
+ */
+bool CPolygonMeshCtrl::GetStoredBoundingBox (sxsdk::vec3& bbMin, sxsdk::vec3& bbMax) const
+{
+	bool found = false;
+	for (size_t i = 0; i < m_vertices.size(); ++i) {
+		const sxsdk::vec3& v = m_vertices[i];
+		if (!std::isfinite(v.x) || !std::isfinite(v.y) || !std::isfinite(v.z)) continue;
+		if (!found) {
+			bbMin = bbMax = v;
+			found = true;
+			continue;
+		}
+		bbMin.x = std::min(bbMin.x, v.x);
+		bbMin.y = std::min(bbMin.y, v.y);
+		bbMin.z = std::min(bbMin.z, v.z);
+		bbMax.x = std::max(bbMax.x, v.x);
+		bbMax.y = std::max(bbMax.y, v.y);
+		bbMax.z = std::max(bbMax.z, v.z);
+	}
+	return found;
+}
+
+/**
+ * 面情報追加.
+ */
+void CPolygonMeshCtrl::AppendPolygon (const int count, const int* indices, const sxsdk::vec3* normals, const sxsdk::vec2* uvs, const int uvStride, const int faceGroupIndex)
+{
+	// 面積のない面/NaNの頂点を持つ面は、BuildFaceGroupsでまとめて除外する.
+	if (count <= 2) return;
 
 	if (faceGroupIndex >= 0) {
-		if (m_currentFaceGroupIndex != faceGroupIndex) {
-			m_currentFaceGroupIndex = faceGroupIndex;
-			m_faceGroupCount++;
+		m_currentFaceGroupIndex = faceGroupIndex;
+		m_faceGroupCount = std::max(m_faceGroupCount, faceGroupIndex + 1);
+	}
+
+	// 凹または平面でない多角形は、三角形に分割して格納 (4角形以下はShade3Dから渡されたままとする).
+	if (count >= 5 && m_triangulateNonConvex && !MathUtil::IsConvexPlanarPolygon(m_vertices, indices, count, m_polygonWork)) {
+		if (MathUtil::TriangulatePolygon(m_vertices, indices, count, m_triangleCorners, m_polygonWork)) {
+			for (size_t i = 0; i < m_triangleCorners.size(); i++) {
+				const int corner = m_triangleCorners[i];
+				m_faceIndices.push_back(indices[corner]);
+				m_faceNormals.push_back(normals[corner]);
+				m_faceUVs.push_back(uvs ? uvs[corner * uvStride] : sxsdk::vec2(0, 0));
+				if ((i % 3) == 2) {
+					m_faceOffsets.push_back((int)m_faceIndices.size());
+					m_faceGroupIndices.push_back((faceGroupIndex >= 0) ? faceGroupIndex : -1);
+				}
+			}
+			return;
 		}
 	}
+
+	m_faceIndices.insert(m_faceIndices.end(), indices, indices + count);
+	m_faceNormals.insert(m_faceNormals.end(), normals, normals + count);
+	if (uvs && uvStride == 1) {
+		m_faceUVs.insert(m_faceUVs.end(), uvs, uvs + count);
+	} else if (uvs) {
+		for (int i = 0; i < count; i++) m_faceUVs.push_back(uvs[i * uvStride]);
+	} else {
+		m_faceUVs.resize(m_faceUVs.size() + count, sxsdk::vec2(0, 0));
+	}
+	m_faceOffsets.push_back((int)m_faceIndices.size());
+	m_faceGroupIndices.push_back((faceGroupIndex >= 0) ? faceGroupIndex : -1);
 }
 
 /**
- * faceGroupごとに分離.
+ * 格納した面が参照するfaceGroup番号のリストを、出力する順番で取得.
+ * faceGroupを参照していない面(-1)、faceGroup番号順となる.
  */
-void CPolygonMeshCtrl::m_Classification()
+void CPolygonMeshCtrl::GetStoredFaceGroupIndexList (std::vector<int>& faceGroupIndexList) const
 {
-	m_outputMeshList.clear();
+	faceGroupIndexList.clear();
 
-	const int faceCou = m_polygons.size();
-	if (faceCou == 0) return;
+	const int bucketCou = (int)m_faceGroupOffsets.size() - 1;
+	for (int i = 0; i < bucketCou; i++) {
+		if (m_faceGroupOffsets[i + 1] > m_faceGroupOffsets[i]) faceGroupIndexList.push_back(i - 1);
+	}
+}
 
-	// faceGroupを参照していない面を格納.
-	m_AdjustmentPoints(-1);
-	if (m_faceGroupCount == 0) return;
+/**
+ * 指定のfaceGroupの出力用ポリゴンメッシュ情報を作成.
+ */
+bool CPolygonMeshCtrl::CreateOutputMesh (const int faceGroupIndex, COutputMeshInfo& outputMeshInfo, CMeshScratch* scratch) const
+{
+	if (scratch) return m_AdjustmentPoints(faceGroupIndex, outputMeshInfo, *scratch);
 
-	// faceGroupを参照する面を格納.
-	for (int i = 0; i < m_faceGroupCount; i++) m_AdjustmentPoints(i);
+	CMeshScratch tmpScratch;
+	return m_AdjustmentPoints(faceGroupIndex, outputMeshInfo, tmpScratch);
 }
 
 /**
  * 法線とUVを頂点ごとに一意になるように分離(頂点を増やす).
+ * 作業用の配列/ハッシュテーブルはscratchのものを使用し、メッシュごとに確保しない.
  */
-void CPolygonMeshCtrl::m_AdjustmentPoints (const int faceGroupIndex)
+bool CPolygonMeshCtrl::m_AdjustmentPoints (const int faceGroupIndex, COutputMeshInfo& outputMeshInfo, CMeshScratch& scratch) const
 {
 	const int orgVCou = m_vertices.size();
-	const int faceCou = m_polygons.size();
 
 	// faceGroupごとの使用している面番号を取得.
-	std::vector<int> faceIndexList;
-	for (int loop = 0; loop < faceCou; loop++) {
-		CMeshPolygon& poly = m_polygons[loop];
-		if (poly.faceGroupIndex != faceGroupIndex) {
-			if (faceIndexList.size() > 0) break;
-			continue;
-		}
-		faceIndexList.push_back(loop);
-	}
-	const int newFaceCou = faceIndexList.size();
-	if (newFaceCou == 0) return;
+	const int bucket = faceGroupIndex + 1;
+	if (bucket < 0 || bucket + 1 >= (int)m_faceGroupOffsets.size()) return false;
+	const int newFaceCou = m_faceGroupOffsets[bucket + 1] - m_faceGroupOffsets[bucket];
+	if (newFaceCou == 0) return false;
+	const int* faceIndexList = &(m_faceGroupFaces[ m_faceGroupOffsets[bucket] ]);
 
-	m_outputMeshList.push_back(COutputMeshInfo());
-	COutputMeshInfo& outputMeshInfo = m_outputMeshList.back();
+	outputMeshInfo.Clear();
 	outputMeshInfo.faceGroupIndex = faceGroupIndex;
 
-	// 使用頂点をチェック.
-	std::vector<int> chkVertices;
+	// 使用頂点をチェックし、元の頂点番号順に番号を振り直す.
+	// faceGroupが頂点全体に対して小さい場合は、頂点全体の配列を作らずに、使用頂点のソート済みリストを二分探索する.
+	size_t cornerCou = 0;
+	for (int loop = 0; loop < newFaceCou; loop++) cornerCou += m_faceOffsets[ faceIndexList[loop] + 1 ] - m_faceOffsets[ faceIndexList[loop] ];
+	const bool denseMap = (cornerCou * 8 >= (size_t)orgVCou);
+
+	std::vector<int>& chkVertices  = scratch.vertexMap;
+	std::vector<int>& usedVertices = scratch.usedVertices;
 	int preVerCou = 0;
-	{
-		chkVertices.resize(orgVCou, -1);
+	if (denseMap) {
+		chkVertices.assign(orgVCou, -1);
 		for (int loop = 0; loop < newFaceCou; loop++) {
-			CMeshPolygon& poly = m_polygons[ faceIndexList[loop] ];
-			const int vCou = poly.indices.size();
-			for (int i = 0; i < vCou; i++) chkVertices[ poly.indices[i] ] = 0;
+			const int faceIndex = faceIndexList[loop];
+			for (int i = m_faceOffsets[faceIndex]; i < m_faceOffsets[faceIndex + 1]; i++) chkVertices[ m_faceIndices[i] ] = 0;
 		}
 		for (int loop = 0; loop < orgVCou; loop++) {
 			if (chkVertices[loop] < 0) continue;
 			chkVertices[loop] = preVerCou;
 			preVerCou++;
 		}
+	} else {
+		usedVertices.clear();
+		usedVertices.reserve(cornerCou);
+		for (int loop = 0; loop < newFaceCou; loop++) {
+			const int faceIndex = faceIndexList[loop];
+			usedVertices.insert(usedVertices.end(), m_faceIndices.begin() + m_faceOffsets[faceIndex], m_faceIndices.begin() + m_faceOffsets[faceIndex + 1]);
+		}
+		std::sort(usedVertices.begin(), usedVertices.end());
+		usedVertices.erase(std::unique(usedVertices.begin(), usedVertices.end()), usedVertices.end());
+		preVerCou = (int)usedVertices.size();
+	}
+
+	const float tolerance    = std::max(m_weldTolerance, 0.0f);
+	const float invTolerance = (tolerance > 0.0f) ? (1.0f / tolerance) : 0.0f;
+
+	// facevaryingとして出力する場合は、頂点を分離しない.
+	// 法線/UVは量子化した値が同一のものを共有し、面の頂点ごとにその番号を持つ.
+	if (m_facevarying) {
+		outputMeshInfo.vertices.resize(preVerCou);
+		outputMeshInfo.faceOffsets.resize(newFaceCou + 1);
+		outputMeshInfo.faceOffsets[0] = 0;
+		outputMeshInfo.faceIndices.resize(cornerCou);
+		outputMeshInfo.normalIndices.resize(cornerCou);
+		outputMeshInfo.uvIndices.resize(cornerCou);
+
+		CWeldTable& normalMap = scratch.normalTable;
+		CWeldTable& uvMap     = scratch.uvTable;
+		normalMap.Reset();
+		uvMap.Reset();
+		std::vector<int>& vertexNormals = scratch.vertexNormals;	// 頂点ごとに最初に参照された法線番号.
+		std::vector<int>& vertexUVs     = scratch.vertexUVs;		// 頂点ごとに最初に参照されたUV番号.
+		vertexNormals.assign(preVerCou, -1);
+		vertexUVs.assign(preVerCou, -1);
+		bool normalContinuous = true;						// すべての頂点で法線が1つの場合はtrue.
+		bool uvContinuous     = true;						// すべての頂点でUVが1つの場合はtrue.
+
+		CWeldKey key;
+		key.orgIndex = 0;
+		for (int i = 0; i < 5; i++) key.values[i] = 0;
+		int corner = 0;
+		for (int loop = 0; loop < newFaceCou; loop++) {
+			const int faceIndex = faceIndexList[loop];
+			const int offset    = m_faceOffsets[faceIndex];
+			const int vCou      = m_faceOffsets[faceIndex + 1] - offset;
+			outputMeshInfo.faceOffsets[loop + 1] = outputMeshInfo.faceOffsets[loop] + vCou;
+
+			for (int i = 0; i < vCou; i++, corner++) {
+				const int orgIndex = m_faceIndices[offset + i];
+				const int index    = denseMap ? chkVertices[orgIndex] : (int)(std::lower_bound(usedVertices.begin(), usedVertices.end(), orgIndex) - usedVertices.begin());
+				const sxsdk::vec3& n  = m_faceNormals[offset + i];
+				const sxsdk::vec2& uv = m_faceUVs[offset + i];
+				outputMeshInfo.vertices[index] = m_vertices[orgIndex];
+				outputMeshInfo.faceIndices[corner] = index;
+
+				// 法線を分けない場合は、頂点で最初に参照された法線を使用.
+				int nIndex = vertexNormals[index];
+				if (m_separateNormal || nIndex < 0) {
+					key.values[0] = QuantizeWeldValue(n.x, invTolerance);
+					key.values[1] = QuantizeWeldValue(n.y, invTolerance);
+					key.values[2] = QuantizeWeldValue(n.z, invTolerance);
+					key.values[3] = 0;
+					key.values[4] = 0;
+					nIndex = FindWeldValue(normalMap, key, 3, n, outputMeshInfo.normals, tolerance);
+					if (nIndex < 0) {
+						nIndex = (int)outputMeshInfo.normals.size();
+						normalMap.Set(key, nIndex);
+						outputMeshInfo.normals.push_back(n);
+					}
+				}
+				if (vertexNormals[index] < 0) vertexNormals[index] = nIndex;
+				else if (vertexNormals[index] != nIndex) normalContinuous = false;
+				outputMeshInfo.normalIndices[corner] = nIndex;
+
+				int uvIndex = vertexUVs[index];
+				if (m_separateUV || uvIndex < 0) {
+					key.values[0] = QuantizeWeldValue(uv.x, invTolerance);
+					key.values[1] = QuantizeWeldValue(uv.y, invTolerance);
+					key.values[2] = 0;
+					key.values[3] = 0;
+					key.values[4] = 0;
+					uvIndex = FindWeldValue(uvMap, key, 2, uv, outputMeshInfo.uvs, tolerance);
+					if (uvIndex < 0) {
+						uvIndex = (int)outputMeshInfo.uvs.size();
+						uvMap.Set(key, uvIndex);
+						outputMeshInfo.uvs.push_back(uv);
+					}
+				}
+				if (vertexUVs[index] < 0) vertexUVs[index] = uvIndex;
+				else if (vertexUVs[index] != uvIndex) uvContinuous = false;
+				outputMeshInfo.uvIndices[corner] = uvIndex;
+			}
+		}
+
+		// 頂点ごとに値が1つに決まる場合は、面の頂点ごとではなく頂点ごとの値にする.
+		// 並べ直した配列と入れ替えた元の配列は、作業用として次のメッシュで再利用する.
+		if (normalContinuous) {
+			std::vector<sxsdk::vec3>& normals = scratch.normals;
+			normals.resize(preVerCou);
+			for (int i = 0; i < preVerCou; i++) normals[i] = outputMeshInfo.normals[ vertexNormals[i] ];
+			outputMeshInfo.normals.swap(normals);
+			outputMeshInfo.normalIndices.clear();
+		}
+		if (uvContinuous) {
+			std::vector<sxsdk::vec2>& uvs = scratch.uvs;
+			uvs.resize(preVerCou);
+			for (int i = 0; i < preVerCou; i++) uvs[i] = outputMeshInfo.uvs[ vertexUVs[i] ];
+			outputMeshInfo.uvs.swap(uvs);
+			outputMeshInfo.uvIndices.clear();
+		}
+		return true;
 	}
 
-	std::vector< std::vector<int> > newVerticesRef;
-	newVerticesRef.resize(preVerCou);
+	// 元の頂点番号と量子化した法線/UVをキーとして、同一の頂点を検索する.
+	// 同じ元の頂点番号を持つ頂点は位置が同じため、位置はキーに含めない.
+	// キーで見つからない場合は、量子化したセルの境界をまたいでいる場合があるため、法線/UVを許容値で比較して探す.
+	// 同じ元の頂点から分離した頂点が少ない場合はそれらを順にたどり、多い場合は隣接するセルを調べる.
+	// いずれも1回の検索は定数回の比較で済むため、全体は頂点数に比例する時間となる.
+	CWeldTable& weldMap = scratch.weldTable;
+	weldMap.Reset(preVerCou * 2);
+	std::vector<int>& nextCopy   = scratch.nextCopy;
+	std::vector<int>& copyCounts = scratch.copyCounts;
+	nextCopy.assign(preVerCou, -1);
+	copyCounts.assign(preVerCou, 1);
+
+	int weldDims[5];				// 比較するキーの要素番号 (法線xyzは0-2、UVxyは3-4).
+	int weldDimCou = 0;
+	if (m_separateNormal) {
+		weldDims[weldDimCou++] = 0;
+		weldDims[weldDimCou++] = 1;
+		weldDims[weldDimCou++] = 2;
+	}
+	if (m_separateUV) {
+		weldDims[weldDimCou++] = 3;
+		weldDims[weldDimCou++] = 4;
+	}
+	int neighborCou = 1;			// 隣接するセルの数.
+	for (int i = 0; i < weldDimCou; i++) neighborCou *= 3;
+	neighborCou--;
 
 	outputMeshInfo.vertices.resize(preVerCou);
 	outputMeshInfo.normals.resize(preVerCou);
 	outputMeshInfo.uvs.resize(preVerCou);
-	outputMeshInfo.faceIndices.resize(newFaceCou);
+	outputMeshInfo.faceOffsets.resize(newFaceCou + 1);
+	outputMeshInfo.faceOffsets[0] = 0;
+	outputMeshInfo.faceIndices.resize(cornerCou);
 
+	std::vector<char>& usedList = scratch.usedList;
+	usedList.assign(preVerCou, 0);
+	CWeldKey key;
 	for (int loop = 0; loop < newFaceCou; loop++) {
-		CMeshPolygon& poly = m_polygons[ faceIndexList[loop] ];
-		const int vCou = poly.indices.size();
-		outputMeshInfo.faceIndices[loop].resize(vCou);
+		const int faceIndex = faceIndexList[loop];
+		const int offset    = m_faceOffsets[faceIndex];
+		const int vCou      = m_faceOffsets[faceIndex + 1] - offset;
+		int* dstIndices     = &outputMeshInfo.faceIndices[ outputMeshInfo.faceOffsets[loop] ];
+		outputMeshInfo.faceOffsets[loop + 1] = outputMeshInfo.faceOffsets[loop] + vCou;
 
 		for (int i = 0; i < vCou; i++) {
-			const int orgIndex = poly.indices[i];
-			const int index    = chkVertices[orgIndex];
-			const int cou      = newVerticesRef[index].size();
-
-			if (cou == 0) {
+			const int orgIndex = m_faceIndices[offset + i];
+			const int index    = denseMap ? chkVertices[orgIndex] : (int)(std::lower_bound(usedVertices.begin(), usedVertices.end(), orgIndex) - usedVertices.begin());
+			const sxsdk::vec3& n  = m_faceNormals[offset + i];
+			const sxsdk::vec2& uv = m_faceUVs[offset + i];
+
+			key.orgIndex  = orgIndex;
+			key.values[0] = m_separateNormal ? QuantizeWeldValue(n.x, invTolerance) : 0;
+			key.values[1] = m_separateNormal ? QuantizeWeldValue(n.y, invTolerance) : 0;
+			key.values[2] = m_separateNormal ? QuantizeWeldValue(n.z, invTolerance) : 0;
+			key.values[3] = m_separateUV ? QuantizeWeldValue(uv.x, invTolerance) : 0;
+			key.values[4] = m_separateUV ? QuantizeWeldValue(uv.y, invTolerance) : 0;
+
+			// 最初に参照された頂点は元の並びの位置に格納し、異なる法線/UVを持つ頂点は末尾に追加する.
+			int searchIndex = index;
+			if (!usedList[index]) {
+				usedList[index] = 1;
 				outputMeshInfo.vertices[index] = m_vertices[orgIndex];
-				outputMeshInfo.normals[index]  = poly.normals[i];
-				outputMeshInfo.uvs[index]      = poly.uvs[i];
-				outputMeshInfo.faceIndices[loop][i] = index;
-				newVerticesRef[index].push_back(index);
+				outputMeshInfo.normals[index]  = n;
+				outputMeshInfo.uvs[index]      = uv;
+				weldMap.Set(key, index);
 
 			} else {
-				int searchIndex = -1;
-				const sxsdk::vec3& v  = m_vertices[orgIndex];
-				const sxsdk::vec3& n  = poly.normals[i];
-				const sxsdk::vec2& uv = poly.uvs[i];
-
-				for (int j = 0; j < cou; j++) {
-					const int index2 = newVerticesRef[index][j];
-					if (sx::zero(outputMeshInfo.vertices[index2] - v) && (!m_separateNormal || sx::zero(outputMeshInfo.normals[index2] - n)) && (!m_separateUV || sx::zero(outputMeshInfo.uvs[index2] - uv))) {
-						searchIndex = index2;
-						break;
+				searchIndex = weldMap.Find(key);
+				if (searchIndex < 0 && tolerance > 0.0f) {
+					const CWeldVertexNear isNear(outputMeshInfo, n, uv, m_separateNormal, m_separateUV, tolerance);
+					if (copyCounts[index] <= neighborCou) {
+						for (int j = index; j >= 0; j = nextCopy[j]) {
+							if (isNear(j)) {
+								searchIndex = j;
+								break;
+							}
+						}
+					} else {
+						searchIndex = FindWeldNeighbor(weldMap, key, weldDims, weldDimCou, isNear);
 					}
 				}
-				if (searchIndex >= 0) {
-					outputMeshInfo.faceIndices[loop][i] = searchIndex;
-				} else {
-					searchIndex = outputMeshInfo.vertices.size();
-					outputMeshInfo.vertices.push_back(v);
+				if (searchIndex < 0) {
+					searchIndex = (int)outputMeshInfo.vertices.size();
+					weldMap.Set(key, searchIndex);
+					outputMeshInfo.vertices.push_back(m_vertices[orgIndex]);
 					outputMeshInfo.normals.push_back(n);
 					outputMeshInfo.uvs.push_back(uv);
-					outputMeshInfo.faceIndices[loop][i] = searchIndex;
-					newVerticesRef[index].push_back(searchIndex);
+
+					// 同じ元の頂点から分離した頂点の先頭(元の頂点の次)につなぐ.
+					nextCopy.push_back(nextCopy[index]);
+					nextCopy[index] = searchIndex;
+					copyCounts[index]++;
 				}
 			}
+			dstIndices[i] = searchIndex;
 		}
 	}
-}
-
-/**
- * faceGroup情報を取得.
- * -1の場合はfaceGroupのない箇所(元の割り当て参照).
- */
-void CPolygonMeshCtrl::GetFaceGroupIndexList (std::vector<int>& faceGroupIndexList)
-{
-	const int cou = m_outputMeshList.size();
-	faceGroupIndexList.resize(cou);
-	for (int i = 0; i < cou; i++) {
-		faceGroupIndexList[i] = m_outputMeshList[i].faceGroupIndex;
-	}
-}
-
-/**
- * 処理済の面数を返す.
- */
-int CPolygonMeshCtrl::GetPolygonsCount (const int meshIndex)
-{
-	return m_outputMeshList[meshIndex].faceIndices.size();
-}
-
-/**
- * 指定の面での頂点インデックスを返す.
- */
-bool CPolygonMeshCtrl::GetPolygonIndices (const int meshIndex, const int polyIndex, std::vector<int>& retIndices)
-{
-	COutputMeshInfo& meshInfo = m_outputMeshList[meshIndex];
-
-	if (polyIndex < 0 || polyIndex >= meshInfo.faceIndices.size()) return false;
-
-	const int vCou = meshInfo.faceIndices[polyIndex].size();
-	retIndices.resize(vCou);
-	for (int i = 0; i < vCou; i++) retIndices[i] = meshInfo.faceIndices[polyIndex][i];
 
 	return true;
 }
-
-/**
- * 処理済の面ごとの頂点数リストを返す.
- */
-bool CPolygonMeshCtrl::GetPolygonsVCount (const int meshIndex, std::vector<int>& retPolygonIndices)
-{
-	COutputMeshInfo& meshInfo = m_outputMeshList[meshIndex];
-
-	const int polyCou = meshInfo.faceIndices.size();
-	retPolygonIndices.resize(polyCou);
-
-	for (int i = 0; i < polyCou; i++) retPolygonIndices[i] = meshInfo.faceIndices[i].size();
-	return true;
-}
-
-/**
- * 処理済の頂点を返す.
- */
-bool CPolygonMeshCtrl::GetOutputVertices (const int meshIndex, std::vector<sxsdk::vec3>& retV)
-{
-	COutputMeshInfo& meshInfo = m_outputMeshList[meshIndex];
-
-	retV.resize(meshInfo.vertices.size());
-	for (int i = 0; i < meshInfo.vertices.size(); i++)  retV[i] = meshInfo.vertices[i];
-	return true;
-}
-
-/**
- * 処理済の法線を返す.
- */
-bool CPolygonMeshCtrl::GetOutputNormals (const int meshIndex, std::vector<sxsdk::vec3>& retN)
-{
-	COutputMeshInfo& meshInfo = m_outputMeshList[meshIndex];
-
-	retN.resize(meshInfo.normals.size());
-	for (int i = 0; i < meshInfo.normals.size(); i++)  retN[i] = meshInfo.normals[i];
-	return true;
-}
-
-/**
- * 処理済のUVを返す.
- */
-bool CPolygonMeshCtrl::GetOutputUVs (const int meshIndex, std::vector<sxsdk::vec2>& retUVs)
-{
-	COutputMeshInfo& meshInfo = m_outputMeshList[meshIndex];
-
-	retUVs.resize(meshInfo.uvs.size());
-	for (int i = 0; i < meshInfo.uvs.size(); i++)  retUVs[i] = meshInfo.uvs[i];
-	return true;
-}
-
-
@@ -7,25 +7,9 @@
 #define _POLYGONMESHCTRL_H
 
 #include "GlobalHeader.h"
+#include "MathUtil.h"
 
-/**
- * ポリゴンメッシュの面情報.
- */
-class CMeshPolygon
-{
-public:
-	std::vector<int> indices;					// 面を構成する頂点インデックス.
-	int faceGroupIndex;							// faceGroup番号.
-
-	std::vector<sxsdk::rgba_class> colors;		// 頂点カラー.
-	std::vector<sxsdk::vec3> normals;			// 法線.
-	std::vector<sxsdk::vec2> uvs;				// UV.
-
-public:
-	CMeshPolygon () {
-		faceGroupIndex = -1;
-	}
-};
+class CMeshScratch;
 
 /**
  * faceGroupごとに分解した出力用ポリゴンメッシュ情報.
@@ -34,15 +18,62 @@ class COutputMeshInfo
 {
 public:
 	int faceGroupIndex;								// faceGroup番号.
-	std::vector< std::vector<int> > faceIndices;	// 面ごとの頂点インデックス.
+
+	// 面iの頂点インデックスは faceIndices[ faceOffsets[i] ] から faceIndices[ faceOffsets[i + 1] - 1 ].
+	std::vector<int> faceOffsets;					// 面ごとの頂点インデックスの開始位置 (要素数は面数 + 1).
+	std::vector<int> faceIndices;					// すべての面の頂点インデックスを連続して格納.
 
 	std::vector<sxsdk::vec3> vertices;				// 頂点座標リスト.
 	std::vector<sxsdk::vec3> normals;				// 法線リスト.
 	std::vector<sxsdk::vec2> uvs;					// UVリスト.
 
+	// facevaryingの場合の、面の頂点ごとの法線/UV番号 (faceIndicesと同じ並び).
+	// 空の場合は、normals/uvsは頂点ごとの値.
+	std::vector<int> normalIndices;					// 面の頂点ごとのnormalsの番号.
+	std::vector<int> uvIndices;						// 面の頂点ごとのuvsの番号.
+
 public:
 	COutputMeshInfo () {
 		faceGroupIndex = -1;
+		faceOffsets.assign(1, 0);
+	}
+
+	/**
+	 * 情報クリア (確保済みの領域は解放しない).
+	 */
+	void Clear () {
+		faceGroupIndex = -1;
+		faceOffsets.assign(1, 0);
+		faceIndices.clear();
+		vertices.clear();
+		normals.clear();
+		uvs.clear();
+		normalIndices.clear();
+		uvIndices.clear();
+	}
+
+	/**
+	 * 面数を取得.
+	 */
+	int GetFacesCount () const { return (int)faceOffsets.size() - 1; }
+
+	/**
+	 * 指定の面の頂点数を取得.
+	 */
+	int GetFaceVerticesCount (const int faceIndex) const { return faceOffsets[faceIndex + 1] - faceOffsets[faceIndex]; }
+
+	/**
+	 * 指定の面の頂点インデックスの先頭を取得 (コピーせずに参照する).
+	 */
+	const int* GetFaceIndices (const int faceIndex) const { return &faceIndices[ faceOffsets[faceIndex] ]; }
+
+	/**
+	 * 確保済みの領域のバイト数を取得.
+	 */
+	size_t GetCapacityBytes () const {
+		return (faceOffsets.capacity() + faceIndices.capacity() + normalIndices.capacity() + uvIndices.capacity()) * sizeof(int)
+		     + (vertices.capacity() + normals.capacity()) * sizeof(sxsdk::vec3)
+		     + uvs.capacity() * sizeof(sxsdk::vec2);
 	}
 };
 
@@ -56,25 +87,47 @@ private:
 
 	std::string m_name;									// 形状名.
 	std::vector<sxsdk::vec3> m_vertices;				// 頂点座標の格納.
-	std::vector<CMeshPolygon> m_polygons;				// 面情報.
-
-	std::vector<COutputMeshInfo> m_outputMeshList;		// 出力用のポリゴンメッシュ情報.
+	sxsdk::mat4 m_transform;							// 頂点座標/法線に適用する変換行列.
+	bool m_hasTransform;								// m_transformを適用する場合はtrue.
+	bool m_transformed;									// 頂点座標/法線の変換と法線の正規化が済んでいる場合はtrue.
+
+	// 面情報 (面ごとにvectorを持たず、すべての面の頂点情報を連続して格納する).
+	// 面iの頂点は m_faceOffsets[i] から m_faceOffsets[i + 1] - 1 の範囲.
+	std::vector<int> m_faceOffsets;						// 面ごとの頂点情報の開始位置 (要素数は面数 + 1).
+	std::vector<int> m_faceIndices;						// 面を構成する頂点インデックス.
+	std::vector<sxsdk::vec3> m_faceNormals;				// 面の頂点ごとの法線.
+	std::vector<sxsdk::vec2> m_faceUVs;					// 面の頂点ごとのUV.
+	std::vector<int> m_faceGroupIndices;				// 面ごとのfaceGroup番号.
 
 	int m_currentFaceGroupIndex;						// 格納中のfaceGroup番号.
-	int m_faceGroupCount;								// faceGroupの数.
+	int m_faceGroupCount;								// faceGroupの数 (参照されたfaceGroup番号の最大 + 1).
+
+	std::vector<int> m_faceGroupOffsets;				// faceGroupごとの面番号リストの開始位置 (faceGroupなし(-1)が先頭、要素数はfaceGroup数 + 2).
+	std::vector<int> m_faceGroupFaces;					// faceGroupごとにまとめた面番号.
 
 	bool m_separateUV;									// UVが異なる場合に頂点を増やして面を分けるか.
 	bool m_separateNormal;								// 法線が異なる場合に頂点を増やして面を分けるか.
+	float m_weldTolerance;								// 頂点を分ける際に、同一の法線/UVとみなす許容値.
+	bool m_facevarying;									// 頂点を分けずに、法線/UVを面の頂点ごとの値(facevarying)にする場合はtrue.
+	bool m_triangulateNonConvex;						// 5角形以上の面で、凹または平面でない面を三角形に分割する場合はtrue.
+	std::vector<int> m_triangleCorners;					// 面を三角形に分割する際の作業用.
+	MathUtil::CPolygonWork m_polygonWork;				// 5角形以上の面の判定/分割の作業用.
 
 	/**
-	 * faceGroupごとに分離.
+	 * 格納した頂点座標/法線をまとめて変換し、法線を正規化.
 	 */
-	void m_Classification();
+	void m_ApplyTransform ();
+
+	/**
+	 * 面積のない面、NaN/Infの頂点を持つ面を除外.
+	 */
+	void m_RemoveInvalidPolygons ();
 
 	/**
 	 * 法線とUVを頂点ごとに一意になるように分離(頂点を増やす).
+	 * @return 指定のfaceGroupの面がない場合はfalse.
 	 */
-	void m_AdjustmentPoints (const int faceGroupIndex);
+	bool m_AdjustmentPoints (const int faceGroupIndex, COutputMeshInfo& outputMeshInfo, CMeshScratch& scratch) const;
 
 public:
 	CPolygonMeshCtrl (sxsdk::shade_interface& shade);
@@ -86,64 +139,90 @@ public:
 
 	/**
 	 * 格納開始.
+	 * @param[in] weldTolerance  法線/UVの各要素の差がこの値以内の場合は頂点を分けない (0の場合は完全一致のみ).
+	 * @param[in] facevarying    頂点を分けずに、法線/UVを面の頂点ごとの値として保持する場合はtrue.
 	 */
-	void BeginStore (const std::string name, const bool separateUV, const bool separateNormal);
+	void BeginStore (const std::string name, const bool separateUV, const bool separateNormal, const float weldTolerance = MESH_WELD_TOLERANCE, const bool facevarying = false);
 
 	/**
-	 * 格納終了.
+	 * 5角形以上の面で、凹または平面でない面を三角形に分割するか (BeginStoreの後に指定).
+	 * PointsPolygonsは凸で平面の多角形を前提とするため、通常はtrue.
+	 * SubdivisionMeshとして出力する場合は、多角形のままでよいためfalseとする.
 	 */
-	void EndStore ();
+	void SetTriangulateNonConvex (const bool triangulate) { m_triangulateNonConvex = triangulate; }
 
 	/**
-	 * 頂点座標追加.
+	 * 頂点座標/法線に適用する変換行列を指定 (BeginStoreの後に指定).
+	 * AppendVertex/AppendPolygonでは変換せずに格納し、BuildFaceGroupsでまとめて変換する.
 	 */
-	void AppendVertex (const sxsdk::vec3& v);
+	void SetTransform (const sxsdk::mat4& m) {
+		m_transform    = m;
+		m_hasTransform = true;
+	}
 
 	/**
-	 * 面情報追加.
+	 * faceGroupごとの面番号リストを作成.
+	 * 面積のない面、NaN/Infの頂点を持つ面はここで除外される.
+	 * GetStoredFaceGroupIndexList、CreateOutputMeshの前に呼ぶこと.
 	 */
-	void AppendPolygon (const std::vector<int>& indices, const std::vector<sxsdk::vec3>& normals, const std::vector<sxsdk::vec2>& uvs, const int faceGroupIndex);
+	void BuildFaceGroups ();
 
 	/**
-	 * 格納しているfaceGroupごとのMesh数を取得.
+	 * 頂点数/面数を指定して、格納領域を確保.
+	 * Shade3Dから通知される数を指定する.
 	 */
-	int GetMeshsCount () { return m_outputMeshList.size(); }
+	void ReserveVertices (const int count);
+	void ReservePolygons (const int count);
 
 	/**
-	 * 処理済の面数を返す.
+	 * 頂点座標追加 (SetTransformで指定した変換前の座標).
+	 */
+	void AppendVertex (const sxsdk::vec3& v);
+
+	/**
+	 * 面情報追加.
+	 * 面の頂点数に制限はない。5角形以上の面は、凸で平面の場合はそのまま格納する.
+	 * 渡された配列から格納領域に直接コピーし、面ごとのメモリ確保は行わない.
+	 * 法線は変換/正規化前のものを渡す.
+	 * @param[in] uvs       UV (NULLの場合は(0, 0)).
+	 * @param[in] uvStride  面の頂点ごとのUVの間隔 (UVが連続している場合は1).
 	 */
-	int GetPolygonsCount (const int faceGroupIndex);
+	void AppendPolygon (const int count, const int* indices, const sxsdk::vec3* normals, const sxsdk::vec2* uvs, const int uvStride, const int faceGroupIndex);
 
 	/**
-	 * faceGroup情報を取得.
-	 * -1の場合はfaceGroupのない箇所(元の割り当て参照).
+	 * 格納した面が参照するfaceGroup番号のリストを、出力する順番で取得.
 	 */
-	void GetFaceGroupIndexList (std::vector<int>& faceGroupIndexList);
+	void GetStoredFaceGroupIndexList (std::vector<int>& faceGroupIndexList) const;
 
 	/**
-	 * 処理済の面ごとの頂点数リストを返す.
+	 * 指定のfaceGroupの出力用ポリゴンメッシュ情報を作成.
+	 * 格納済みの情報を参照するだけのため、異なるスレッドから同時に呼び出せる.
+	 * @param[in] scratch  作業領域 (スレッドごとに異なるものを指定。NULLの場合は一時的に確保する).
+	 * @return 指定のfaceGroupの面がない場合はfalse.
 	 */
-	bool GetPolygonsVCount (const int meshIndex, std::vector<int>& retPolygonIndices);
+	bool CreateOutputMesh (const int faceGroupIndex, COutputMeshInfo& outputMeshInfo, CMeshScratch* scratch = NULL) const;
 
 	/**
-	 * 指定の面での頂点インデックスを返す.
+	 * 格納した頂点数を取得.
 	 */
-	bool GetPolygonIndices (const int meshIndex, const int polyIndex, std::vector<int>& retIndices);
+	int GetVerticesCount () const { return (int)m_vertices.size(); }
 
 	/**
-	 * 処理済の頂点を返す.
+	 * 確保済みの領域のバイト数を取得 (再利用する場合の上限の判定用).
 	 */
-	bool GetOutputVertices (const int meshIndex, std::vector<sxsdk::vec3>& retV);
+	size_t GetCapacityBytes () const;
 
 	/**
-	 * 処理済の法線を返す.
+	 * 格納した頂点のバウンディングボックスを取得 (SetTransformで指定した変換前の座標).
+	 * NaN/Infの頂点は含めない.
+	 * @return 有効な頂点がない場合はfalse.
 	 */
-	bool GetOutputNormals (const int meshIndex, std::vector<sxsdk::vec3>& retN);
+	bool GetStoredBoundingBox (sxsdk::vec3& bbMin, sxsdk::vec3& bbMax) const;
 
 	/**
-	 * 処理済のUVを返す.
+	 * 格納した面数を取得.
 	 */
-	bool GetOutputUVs (const int meshIndex, std::vector<sxsdk::vec2>& retUVs);
+	int GetStoredPolygonsCount () const { return (int)m_faceGroupIndices.size(); }
 };
 
 #endif
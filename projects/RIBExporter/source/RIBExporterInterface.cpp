@@ -36,6 +36,29 @@ enum
 
 	dlg_subdivision_id = 240,						// Subdivision.
 	dlg_denoise_id = 241,							// Denoise.
+
+	dlg_rib_encoding_id = 601,						// RIBの出力形式.
+	dlg_rib_compress_id = 602,						// RIBをgzip圧縮して出力.
+	dlg_geometry_archive_id = 603,					// 形状をアーカイブファイルに分けて出力.
+	dlg_geometry_cache_id = 604,					// 変更のない形状アーカイブを再利用.
+	dlg_parallel_output_id = 605,					// 形状の出力処理を複数スレッドで行う.
+	dlg_object_instance_id = 606,					// リンクされた形状をインスタンスとして出力.
+	dlg_precision_p_id = 607,						// 頂点座標(P)の有効桁数.
+	dlg_precision_n_id = 608,						// 法線(N)の小数点以下の桁数.
+	dlg_precision_st_id = 609,						// UV(st)の小数点以下の桁数.
+	dlg_quantize_grid_id = 610,						// 頂点座標(P)の量子化の間隔.
+	dlg_streaming_output_id = 611,					// 形状を分割して直接出力 (メモリ使用量を抑える).
+	dlg_profile_export_id = 612,					// エクスポート処理を計測して表示.
+	dlg_profile_trace_id = 613,						// 計測結果をJSONファイルに保存.
+	dlg_weld_tolerance_id = 614,					// 法線/UVで頂点を分ける際の許容値.
+	dlg_facevarying_primvars_id = 615,				// 法線/UVをfacevaryingで出力.
+	dlg_lod_decimation_id = 616,					// 遠くの形状を簡略化.
+	dlg_lod_pixel_size_id = 617,					// 簡略化後の辺の長さ(ピクセル).
+	dlg_ngon_passthrough_id = 618,					// 5角形以上の面を分割しない.
+	dlg_local_space_geometry_id = 619,				// 形状をローカル座標で出力.
+	dlg_frustum_culling_id = 620,					// カメラの視野外の形状を出力しない.
+	dlg_cull_margin_id = 621,						// 視野の余白 (%).
+	dlg_cull_keep_radius_id = 622,					// 常に出力するカメラからの距離.
 };
 
 enum {
@@ -52,6 +75,10 @@ CRIBExporterInterface::CRIBExporterInterface (sxsdk::shade_interface& shade) : s
 	m_pCurrentShape = NULL;
 	m_pSaveRIB = NULL;
 	m_dlgOK = false;
+	m_skip = false;
+	m_skipPolymesh = false;
+	m_instancePolymesh = false;
+	m_useSpMat = false;
 }
 
 CRIBExporterInterface::~CRIBExporterInterface ()
@@ -108,11 +135,16 @@ void CRIBExporterInterface::do_export (sxsdk::plugin_exporter_interface *plugin_
 	m_pluginExporter->do_export();
 
 	// エクスポート終了.
-	m_pSaveRIB->EndExport();
+	// 出力できなかった形状がある場合は、RIBが不完全であることを表示する.
+	const bool succeeded = m_pSaveRIB->EndExport();
 
 	{
 		std::stringstream s;
-		s << "Export " << m_pSaveRIB->GetRIBFileName() << ".";
+		if (succeeded) {
+			s << "Export " << m_pSaveRIB->GetRIBFileName() << ".";
+		} else {
+			s << "Export failed : " << m_pSaveRIB->GetRIBFileName() << " is incomplete.";
+		}
 		shade.message(s.str().c_str());
 	}
 
@@ -155,6 +187,7 @@ void CRIBExporterInterface::begin (void *)
 	m_shapeStack.Push(m_currentDepth, m_pCurrentShape, gMat);
 
 	m_spMat = sxsdk::mat4::identity;
+	m_useSpMat = false;
 	m_currentLWMatrix = gMat;
 
 	m_currentDepth++;
@@ -186,7 +219,7 @@ void CRIBExporterInterface::end (void *)
 	if (pShape && depth > 0) {
 		m_pCurrentShape  = pShape;
 		m_currentDepth   = depth;
-		m_currentLWMatrix = inv(pShape->get_transformation()) * m_shapeStack.GetLocalToWorldMatrix();
+		m_currentLWMatrix = m_shapeStack.GetShapeLocalToWorldMatrix();
 	}
 }
 
@@ -196,6 +229,7 @@ void CRIBExporterInterface::end (void *)
 void CRIBExporterInterface::set_transformation (const sxsdk::mat4 &t, void *)
 {
 	m_spMat = t;
+	m_useSpMat = true;
 }
 
 /**
@@ -204,6 +238,21 @@ void CRIBExporterInterface::set_transformation (const sxsdk::mat4 &t, void *)
 void CRIBExporterInterface::clear_transformation (void *)
 {
 	m_spMat = sxsdk::mat4::identity;
+	m_useSpMat = false;
+}
+
+/**
+ * カレント形状がリンク先の形状として参照されているか.
+ * 親をたどってリンク形状がある場合は、同じ形状が複数回エクスポートされる.
+ */
+bool CRIBExporterInterface::m_IsLinkedShape ()
+{
+	std::vector<sxsdk::shape_class *> shapes;
+	const int cou = m_shapeStack.GetShapes(shapes);
+	for (int i = 1; i < cou; ++i) {
+		if (shapes[i] && shapes[i]->get_type() == sxsdk::enums::link) return true;
+	}
+	return false;
 }
 
 /**
@@ -215,7 +264,20 @@ void CRIBExporterInterface::begin_polymesh (void *)
 
 	m_LWMat = m_spMat * m_currentLWMatrix;
 	m_currentFaceGroupIndex = -1;
-	m_pSaveRIB->BeginPolygonMesh(m_pCurrentShape);
+	m_skipPolymesh     = false;
+	m_instancePolymesh = false;
+
+	// リンクされた形状は、ObjectBegin/ObjectEndで一度だけ出力してObjectInstanceで参照する.
+	// 出力済みの場合は、ObjectInstanceのみを出力して頂点/面情報は格納しない.
+	if (m_data.objectInstance && !m_useSpMat && m_IsLinkedShape()) {
+		m_instancePolymesh = true;
+		if (m_pSaveRIB->WritePolygonMeshInstance(m_pCurrentShape, m_LWMat)) {
+			m_skipPolymesh = true;
+			return;
+		}
+	}
+
+	m_pSaveRIB->BeginPolygonMesh(m_pCurrentShape, m_LWMat, m_instancePolymesh);
 }
 
 /**
@@ -223,7 +285,10 @@ void CRIBExporterInterface::begin_polymesh (void *)
  */
 void CRIBExporterInterface::begin_polymesh_vertex (int n, void *)
 {
-	if (m_skip) return;
+	if (m_skip || m_skipPolymesh) return;
+
+	// 頂点数分の格納領域を確保.
+	m_pSaveRIB->ReservePolygonMeshVertex(n);
 }
 
 /**
@@ -231,14 +296,11 @@ void CRIBExporterInterface::begin_polymesh_vertex (int n, void *)
  */
 void CRIBExporterInterface::polymesh_vertex (int i, const sxsdk::vec3 &v, const sxsdk::skin_class *skin)
 {
-	if (m_skip) return;
+	if (m_skip || m_skipPolymesh) return;
 
-	// 座標値をワールド座標変換する.
-	sxsdk::vec3 pos = v;
+	// ワールド座標への変換は、格納後にCPolygonMeshCtrlでまとめて行う (インスタンスとして出力する場合はローカル座標のまま).
 	//if (skin) pos = pos * (skin->get_skin_world_matrix());
-	pos = pos * m_LWMat;
-
-	m_pSaveRIB->AppendPolygonMeshVertex(pos);
+	m_pSaveRIB->AppendPolygonMeshVertex(v);
 }
 
 /**
@@ -246,32 +308,12 @@ void CRIBExporterInterface::polymesh_vertex (int i, const sxsdk::vec3 &v, const
  */
 void CRIBExporterInterface::polymesh_face_uvs (int n_list, const int list[], const sxsdk::vec3 *normals, const sxsdk::vec4 *plane_equation, const int n_uvs, const sxsdk::vec2 *uvs, void *)
 {
-	if (m_skip) return;
-
-	std::vector<int> indicesList;
-	std::vector<sxsdk::vec3> normalsList;
-	std::vector<sxsdk::vec2> uvsList;
+	if (m_skip || m_skipPolymesh) return;
+	if (n_list <= 0) return;
 
-	indicesList.resize(n_list);
-	normalsList.resize(n_list);
-	uvsList.resize(n_list, sxsdk::vec2(0, 0));
-
-	sxsdk::vec4 v4;
-	for (int i = 0; i < n_list; i++) {
-		indicesList[i] = list[i];
-		v4 = sxsdk::vec4(normals[i], 0) * m_LWMat;
-		normalsList[i] = normalize(sxsdk::vec3(v4.x, v4.y, v4.z));
-	}
-
-	if (n_uvs > 0 && uvs != NULL) {
-		int iPos = 0;
-		for (int i = 0; i < n_list; i++) {
-			uvsList[i] = uvs[iPos];
-			iPos += n_uvs;
-		}
-	}
-
-	m_pSaveRIB->AppendPolygonMeshPolygon(indicesList, normalsList, uvsList, m_currentFaceGroupIndex);
+	// 頂点インデックス/法線/UVはShade3Dから渡された配列を直接参照する (UVは頂点ごとにn_uvs個ずつ並んでおり、先頭のUVを使用).
+	// 法線の変換と正規化は、格納後にCPolygonMeshCtrlでまとめて行う.
+	m_pSaveRIB->AppendPolygonMeshPolygon(n_list, list, normals, (n_uvs > 0) ? uvs : NULL, n_uvs, m_currentFaceGroupIndex);
 }
 
 /**
@@ -280,6 +322,10 @@ void CRIBExporterInterface::polymesh_face_uvs (int n_list, const int list[], con
 void CRIBExporterInterface::end_polymesh (void *)
 {
 	if (m_skip) return;
+	if (m_skipPolymesh) {
+		m_skipPolymesh = false;
+		return;
+	}
 
 	m_pSaveRIB->EndPolygonMesh();
 }
@@ -289,7 +335,10 @@ void CRIBExporterInterface::end_polymesh (void *)
  */
 void CRIBExporterInterface::begin_polymesh_face2 (int n, int number_of_face_groups, void *)
 {
-	if (m_skip) return;
+	if (m_skip || m_skipPolymesh) return;
+
+	// 面数分の格納領域を確保.
+	m_pSaveRIB->ReservePolygonMeshPolygon(n);
 }
 
 /**
@@ -297,7 +346,7 @@ void CRIBExporterInterface::begin_polymesh_face2 (int n, int number_of_face_grou
  */
 void CRIBExporterInterface::begin_polymesh_face_group (int face_group_index, void *)
 {
-	if (m_skip) return;
+	if (m_skip || m_skipPolymesh) return;
 	m_currentFaceGroupIndex = face_group_index;
 }
 
@@ -448,6 +497,122 @@ void CRIBExporterInterface::load_dialog_data (sxsdk::dialog_interface &d, void *
 		item->set_bool(m_data.doDenoise);
 	}
 
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_rib_encoding_id));
+		item->set_selection((int)m_data.ribEncoding);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_rib_compress_id));
+		item->set_bool(m_data.ribCompress);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_geometry_archive_id));
+		item->set_bool(m_data.geometryArchive);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_geometry_cache_id));
+		item->set_bool(m_data.geometryCache);
+		item->set_enabled(m_data.geometryArchive);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_parallel_output_id));
+		item->set_bool(m_data.parallelOutput);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_object_instance_id));
+		item->set_bool(m_data.objectInstance);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_precision_p_id));
+		item->set_int(m_data.precisionP);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_precision_n_id));
+		item->set_int(m_data.precisionN);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_precision_st_id));
+		item->set_int(m_data.precisionST);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_quantize_grid_id));
+		item->set_float(m_data.quantizeGrid);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_streaming_output_id));
+		item->set_bool(m_data.streamingOutput);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_profile_export_id));
+		item->set_bool(m_data.profileExport);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_profile_trace_id));
+		item->set_bool(m_data.profileTrace);
+		item->set_enabled(m_data.profileExport);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_weld_tolerance_id));
+		item->set_float(m_data.weldTolerance);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_facevarying_primvars_id));
+		item->set_bool(m_data.facevaryingPrimvars);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_lod_decimation_id));
+		item->set_bool(m_data.lodDecimation);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_lod_pixel_size_id));
+		item->set_float(m_data.lodPixelSize);
+		item->set_enabled(m_data.lodDecimation);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_ngon_passthrough_id));
+		item->set_bool(m_data.ngonPassthrough);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_local_space_geometry_id));
+		item->set_bool(m_data.localSpaceGeometry);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_frustum_culling_id));
+		item->set_bool(m_data.frustumCulling);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_cull_margin_id));
+		item->set_float(m_data.cullMargin);
+		item->set_enabled(m_data.frustumCulling);
+	}
+	{
+		sxsdk::dialog_item_class* item;
+		item = &(d.get_dialog_item(dlg_cull_keep_radius_id));
+		item->set_float(m_data.cullKeepRadius);
+		item->set_enabled(m_data.frustumCulling);
+	}
+
 }
 
 void CRIBExporterInterface::save_dialog_data (sxsdk::dialog_interface &dialog,void *)
@@ -576,6 +741,114 @@ bool CRIBExporterInterface::respond (sxsdk::dialog_interface &dialog, sxsdk::dia
 		m_data.doDenoise = item.get_bool();
 		return true;
 	}
+	if (id == dlg_rib_encoding_id) {
+		m_data.ribEncoding = (RIBParam::RIB_ENCODING_TYPE)item.get_selection();
+		return true;
+	}
+	if (id == dlg_rib_compress_id) {
+		m_data.ribCompress = item.get_bool();
+		return true;
+	}
+	if (id == dlg_geometry_archive_id) {
+		m_data.geometryArchive = item.get_bool();
+		{
+			sxsdk::dialog_item_class &item2 = dialog.get_dialog_item(dlg_geometry_cache_id);
+			item2.set_enabled(m_data.geometryArchive);
+		}
+		return true;
+	}
+	if (id == dlg_geometry_cache_id) {
+		m_data.geometryCache = item.get_bool();
+		return true;
+	}
+	if (id == dlg_parallel_output_id) {
+		m_data.parallelOutput = item.get_bool();
+		return true;
+	}
+	if (id == dlg_object_instance_id) {
+		m_data.objectInstance = item.get_bool();
+		return true;
+	}
+	if (id == dlg_precision_p_id) {
+		m_data.precisionP = item.get_int();
+		return true;
+	}
+	if (id == dlg_precision_n_id) {
+		m_data.precisionN = item.get_int();
+		return true;
+	}
+	if (id == dlg_precision_st_id) {
+		m_data.precisionST = item.get_int();
+		return true;
+	}
+	if (id == dlg_quantize_grid_id) {
+		m_data.quantizeGrid = item.get_float();
+		return true;
+	}
+	if (id == dlg_streaming_output_id) {
+		m_data.streamingOutput = item.get_bool();
+		return true;
+	}
+	if (id == dlg_profile_export_id) {
+		m_data.profileExport = item.get_bool();
+		{
+			sxsdk::dialog_item_class &item2 = dialog.get_dialog_item(dlg_profile_trace_id);
+			item2.set_enabled(m_data.profileExport);
+		}
+		return true;
+	}
+	if (id == dlg_profile_trace_id) {
+		m_data.profileTrace = item.get_bool();
+		return true;
+	}
+	if (id == dlg_weld_tolerance_id) {
+		m_data.weldTolerance = item.get_float();
+		return true;
+	}
+	if (id == dlg_facevarying_primvars_id) {
+		m_data.facevaryingPrimvars = item.get_bool();
+		return true;
+	}
+	if (id == dlg_lod_decimation_id) {
+		m_data.lodDecimation = item.get_bool();
+		{
+			sxsdk::dialog_item_class &item2 = dialog.get_dialog_item(dlg_lod_pixel_size_id);
+			item2.set_enabled(m_data.lodDecimation);
+		}
+		return true;
+	}
+	if (id == dlg_lod_pixel_size_id) {
+		m_data.lodPixelSize = item.get_float();
+		return true;
+	}
+	if (id == dlg_ngon_passthrough_id) {
+		m_data.ngonPassthrough = item.get_bool();
+		return true;
+	}
+	if (id == dlg_local_space_geometry_id) {
+		m_data.localSpaceGeometry = item.get_bool();
+		return true;
+	}
+	if (id == dlg_frustum_culling_id) {
+		m_data.frustumCulling = item.get_bool();
+		{
+			sxsdk::dialog_item_class &item2 = dialog.get_dialog_item(dlg_cull_margin_id);
+			item2.set_enabled(m_data.frustumCulling);
+		}
+		{
+			sxsdk::dialog_item_class &item2 = dialog.get_dialog_item(dlg_cull_keep_radius_id);
+			item2.set_enabled(m_data.frustumCulling);
+		}
+		return true;
+	}
+	if (id == dlg_cull_margin_id) {
+		m_data.cullMargin = item.get_float();
+		return true;
+	}
+	if (id == dlg_cull_keep_radius_id) {
+		m_data.cullKeepRadius = item.get_float();
+		return true;
+	}
 
 	return false;
 }
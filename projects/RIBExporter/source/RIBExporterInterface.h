@@ -30,14 +30,22 @@ private:
 	sxsdk::mat4 m_currentLWMatrix;				// カレントのローカルワールド変換行列.
 	sxsdk::mat4 m_LWMat;
 	sxsdk::mat4 m_spMat;						// 掃引体時の変換行列.
+	bool m_useSpMat;							// 掃引体時の変換行列が指定されている場合はtrue.
 
 	CSaveRIB* m_pSaveRIB;						// RIB出力クラス.
 
 	bool m_skip;								// 処理を飛ばす場合.
+	bool m_skipPolymesh;						// 出力済みのインスタンスのため、ポリゴンメッシュの情報を飛ばす場合.
+	bool m_instancePolymesh;					// ポリゴンメッシュをローカル座標で格納し、インスタンスとして出力する場合.
 	bool m_dlgOK;								// ダイアログでOKボタンを押して進めたか.
 
 	int m_currentFaceGroupIndex;				// faceGroup番号.
 
+	/**
+	 * カレント形状がリンク先の形状として参照されているか.
+	 */
+	bool m_IsLinkedShape ();
+
 	virtual sx::uuid_class get_uuid (void *) { return RIB_EXPORTER_ID; }
 	virtual int get_shade_version () const { return SHADE_BUILD_NUMBER; }
 
@@ -95,8 +103,9 @@ private:
 
 	/**
 	 * 受け付けることのできるポリゴンメッシュ面の頂点の最大数.
+	 * 5角形以上の面を分割しない場合は、PointsPolygonsがそのまま受け付けられるため上限を設けない.
 	 */
-	virtual int get_max_vertices_per_face (void *) { return 4; }
+	virtual int get_max_vertices_per_face (void *) { return m_data.ngonPassthrough ? RIB_MAX_VERTICES_PER_FACE : 4; }
 
 	/**
 	 * ポリゴンメッシュの面は分割しない.
@@ -111,13 +120,16 @@ private:
 	/**
 	 * ポリゴンメッシュの面を分割するか.
 	 * ここをfalseにしget_max_vertices_per_faceが4の場合は、極力4角形は保つ。5角形以上は4角形と3角形に分割される.
+	 * 5角形以上の面を分割しない場合、凹または平面でない面はCPolygonMeshCtrlで三角形に分割する.
 	 */
 	virtual bool must_divide_polymesh (void *aux=0) { return false; }
 
 	/**
 	 * バイナリで出力.
+	 * RIB EncodingでBinaryを選択した場合は、形状情報をRenderManのBinary encodingで出力する.
+	 * 出力はstream_interface::writeでそのまま書き込むため、Shade3D側の「バイナリ/テキスト」の選択(ダイアログでは無効化)には依存しない.
 	 */
-	virtual bool can_export_binary (void * = 0) { return false; }
+	virtual bool can_export_binary (void * = 0) { return true; }
 	virtual bool can_export_text (void * = 0) { return true; }
 
 	virtual bool cannot_select_eol (void *aux=0) { return true; }
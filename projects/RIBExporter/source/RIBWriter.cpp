@@ -0,0 +1,827 @@
+﻿/**
+ * RIBの出力クラス.
+ * ASCII形式と、RenderManのBinary encodingでの出力を切り替える.
+ * 出力はバッファに追記し、一定サイズごとにまとめてstreamに書き出す.
+ */
+
+#include "RIBWriter.h"
+
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include "zlib.h"
+
+namespace {
+	/*
+		RenderManのBinary encodingで使用するコード.
+		(RenderMan Interface Specification 3.2 Appendix C.2).
+	*/
+	const unsigned char RIB_BIN_INT            = 0x80;		// 0x80 + w : w+1バイトの整数.
+	const unsigned char RIB_BIN_SHORT_STRING   = 0x90;		// 0x90 + 長さ(0-15) : 短い文字列.
+	const unsigned char RIB_BIN_LONG_STRING    = 0xa0;		// 0xa0 + l : l+1バイトの長さを持つ文字列.
+	const unsigned char RIB_BIN_REQUEST        = 0xa6;		// 定義済みのリクエストの参照.
+	const unsigned char RIB_BIN_FLOAT_ARRAY    = 0xc8;		// 0xc8 + l : l+1バイトの要素数を持つ実数の配列.
+	const unsigned char RIB_BIN_DEFINE_REQUEST = 0xcc;		// リクエストの定義.
+	const unsigned char RIB_BIN_DEFINE_STRING  = 0xcd;		// 0xcd + l : l+1バイトのトークンで文字列を定義.
+	const unsigned char RIB_BIN_STRING_TOKEN   = 0xcf;		// 0xcf + l : l+1バイトのトークンで定義済みの文字列を参照.
+
+	const int RIB_BIN_MAX_REQUESTS      = 256;				// 定義できるリクエストの最大数.
+	const int RIB_BIN_MAX_STRING_TOKENS = 65536;			// 定義できる文字列の最大数.
+
+	const size_t RIB_WRITER_BUFFER_SIZE = 1024 * 1024;		// streamにまとめて書き出すバッファサイズ.
+	const size_t RIB_WRITER_ZBUFFER_SIZE = 256 * 1024;		// 圧縮後のデータの出力バッファサイズ.
+	const size_t RIB_WRITER_MEMORY_BUFFER_SIZE = 64 * 1024;	// メモリ上に出力する場合の初期バッファサイズ.
+
+	// 10のべき乗 (doubleで正確に表現できる範囲).
+	const double g_pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const unsigned long long g_pow10Int[] = {
+		1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL
+	};
+
+	/**
+	 * 値を格納するのに必要なバイト数 (1-4).
+	 */
+	int GetByteCount (const unsigned int value) {
+		if (value <= 0xff) return 1;
+		if (value <= 0xffff) return 2;
+		if (value <= 0xffffff) return 3;
+		return 4;
+	}
+
+	/**
+	 * 符号なし整数をテキストに変換.
+	 */
+	int FormatUInt64 (char* buff, unsigned long long value) {
+		char digits[24];
+		int cou = 0;
+		do {
+			digits[cou++] = (char)('0' + (int)(value % 10));
+			value /= 10;
+		} while (value > 0);
+		for (int i = 0; i < cou; ++i) buff[i] = digits[cou - i - 1];
+		return cou;
+	}
+
+	/**
+	 * v * 10^p を計算.
+	 */
+	double MulPow10 (double v, int p) {
+		if (p >= 0) {
+			while (p > 22) {
+				v *= 1e22;
+				p -= 22;
+			}
+			return v * g_pow10[p];
+		}
+		p = -p;
+		while (p > 22) {
+			v /= 1e22;
+			p -= 22;
+		}
+		return v / g_pow10[p];
+	}
+}
+
+/**
+ * 整数をテキストに変換.
+ */
+int RIBWriterUtil::FormatInt (char* buff, const int value)
+{
+	char digits[12];
+	int cou = 0;
+	unsigned int v = (value < 0) ? (0u - (unsigned int)value) : (unsigned int)value;
+	do {
+		digits[cou++] = (char)('0' + (v % 10));
+		v /= 10;
+	} while (v > 0);
+
+	char* p = buff;
+	if (value < 0) *p++ = '-';
+	while (cou > 0) *p++ = digits[--cou];
+	return (int)(p - buff);
+}
+
+/**
+ * 実数を、読み戻して同じ値になる最短の桁数でテキストに変換.
+ * 6桁から順に桁数を増やし、floatに戻して一致した桁数で出力する (floatは9桁で必ず一致する).
+ * 有効桁数を指定した場合は、その桁数で丸める.
+ * NaN/Infは、RIBとして解釈できないため0として出力.
+ */
+int RIBWriterUtil::FormatFloat (char* buff, const float value, const int significantDigits)
+{
+	char* p = buff;
+	if (value == 0.0f || !std::isfinite(value)) {
+		*p = '0';
+		return 1;
+	}
+
+	float av = value;
+	if (value < 0.0f) {
+		*p++ = '-';
+		av = -value;
+	}
+	const double d = (double)av;
+
+	// 仮数mと、先頭桁の10進での指数e10を求める (av = m * 10^(e10 - digits + 1)).
+	int e10 = (int)std::floor(std::log10(d));
+	const int fixedDigits = std::min(significantDigits, 9);
+	int digits = (fixedDigits > 0) ? fixedDigits : 6;
+	unsigned long long m = 0;
+	while (true) {
+		m = (unsigned long long)(MulPow10(d, digits - 1 - e10) + 0.5);
+		if (m >= g_pow10Int[digits]) {				// 桁上がり/log10の誤差.
+			e10++;
+			m = (unsigned long long)(MulPow10(d, digits - 1 - e10) + 0.5);
+		} else if (m < g_pow10Int[digits - 1]) {	// log10の誤差.
+			e10--;
+			m = (unsigned long long)(MulPow10(d, digits - 1 - e10) + 0.5);
+		}
+		if (digits >= 9 || fixedDigits > 0) break;
+		if ((float)MulPow10((double)m, e10 - digits + 1) == av) break;
+		digits++;
+	}
+
+	// 末尾の0をカット.
+	while (digits > 1 && (m % 10) == 0) {
+		m /= 10;
+		digits--;
+	}
+
+	char digitsText[10];
+	for (int i = digits - 1; i >= 0; --i) {
+		digitsText[i] = (char)('0' + (int)(m % 10));
+		m /= 10;
+	}
+
+	if (e10 >= -5 && e10 < 9) {
+		if (e10 >= 0) {
+			const int intDigits = e10 + 1;
+			if (digits <= intDigits) {
+				for (int i = 0; i < digits; ++i) *p++ = digitsText[i];
+				for (int i = digits; i < intDigits; ++i) *p++ = '0';
+			} else {
+				for (int i = 0; i < intDigits; ++i) *p++ = digitsText[i];
+				*p++ = '.';
+				for (int i = intDigits; i < digits; ++i) *p++ = digitsText[i];
+			}
+		} else {
+			*p++ = '0';
+			*p++ = '.';
+			for (int i = 0; i < -e10 - 1; ++i) *p++ = '0';
+			for (int i = 0; i < digits; ++i) *p++ = digitsText[i];
+		}
+	} else {
+		*p++ = digitsText[0];
+		if (digits > 1) {
+			*p++ = '.';
+			for (int i = 1; i < digits; ++i) *p++ = digitsText[i];
+		}
+		*p++ = 'e';
+		p += FormatInt(p, e10);
+	}
+
+	return (int)(p - buff);
+}
+
+/**
+ * 実数を、小数点以下の桁数を指定してテキストに変換.
+ * 整数部が大きく桁数が収まらない場合は、FormatFloatで出力する.
+ */
+int RIBWriterUtil::FormatFloatFixed (char* buff, const double value, const int decimals)
+{
+	char* p = buff;
+	if (!std::isfinite(value)) {
+		*p = '0';
+		return 1;
+	}
+	int dec = std::max(0, std::min(decimals, 9));
+	const double scaled = std::abs(value) * g_pow10[dec];
+	if (scaled >= 1e18) return FormatFloat(buff, (float)value);
+
+	unsigned long long m = (unsigned long long)(scaled + 0.5);
+	if (m == 0) {
+		*p = '0';
+		return 1;
+	}
+	if (value < 0.0) *p++ = '-';
+
+	// 末尾の0をカット.
+	while (dec > 0 && (m % 10) == 0) {
+		m /= 10;
+		dec--;
+	}
+
+	p += FormatUInt64(p, m / g_pow10Int[dec]);
+	if (dec > 0) {
+		char fracText[24];
+		const int len = FormatUInt64(fracText, m % g_pow10Int[dec]);
+		*p++ = '.';
+		for (int i = len; i < dec; ++i) *p++ = '0';
+		for (int i = 0; i < len; ++i) *p++ = fracText[i];
+	}
+	return (int)(p - buff);
+}
+
+/**
+ * 量子化の間隔を、10進数の整数 gridUnits * 10^-decimals として表す場合の桁数を取得.
+ * 0.001などfloatで正確に表せない間隔は、10進数の値として扱う.
+ */
+int RIBWriterUtil::GetGridDecimals (const float grid, double& gridUnits)
+{
+	gridUnits = 0.0;
+	if (!(grid > 0.0f)) return -1;
+	for (int d = 0; d <= 9; ++d) {
+		const double s = (double)grid * g_pow10[d];
+		const double r = std::floor(s + 0.5);
+		if (r >= 1.0 && std::abs(s - r) <= s * 1e-6) {
+			gridUnits = r;
+			return d;
+		}
+	}
+	return -1;
+}
+
+/**
+ * 値を量子化の間隔の倍数に丸める.
+ * 間隔を10進数で表せる場合は、10^gridDecimals倍した整数上で丸めるため、
+ * 小数点以下gridDecimals桁で出力すると間隔の倍数に正確に一致し、元の値との差はgrid/2以下になる.
+ */
+double RIBWriterUtil::Quantize (const float value, const float grid, const int gridDecimals, const double gridUnits)
+{
+	if (!std::isfinite(value)) return 0.0;
+	if (gridDecimals < 0) return std::floor((double)value / (double)grid + 0.5) * (double)grid;
+
+	const double k = std::floor((double)value * g_pow10[gridDecimals] / gridUnits + 0.5);
+	return (k * gridUnits) / g_pow10[gridDecimals];
+}
+
+//-----------------------------------------------------------.
+
+CRIBWriter::CRIBWriter (sxsdk::stream_interface* stream, const RIBParam::RIB_ENCODING_TYPE encoding) : m_stream(stream), m_encoding(encoding)
+{
+	m_fp         = NULL;
+	m_zStream    = NULL;
+	m_buffer.resize(stream ? RIB_WRITER_BUFFER_SIZE : RIB_WRITER_MEMORY_BUFFER_SIZE);
+	m_bufferPos  = 0;
+	m_totalBytes = 0;
+	m_lineTop    = true;
+	m_deferredCount = 0;
+	m_writeError = false;
+	m_arrayType  = rib_array_none;
+}
+
+CRIBWriter::~CRIBWriter ()
+{
+	// streamはエクスポート終了後には無効になっているため、ファイル出力の場合のみ閉じる.
+	if (m_fp) Close();
+}
+
+/**
+ * 出力先をファイルに切り替える.
+ */
+bool CRIBWriter::Open (const std::string& filePath, const bool compress)
+{
+	FILE* fp = fopen(filePath.c_str(), "wb");
+	if (!fp) return false;
+
+	// 圧縮を開始できない場合は、非圧縮の内容を.gzとして出力しないように失敗とする.
+	z_stream_s* zStream = NULL;
+	if (compress) {
+		zStream = new z_stream;
+		memset(zStream, 0, sizeof(z_stream));
+
+		// windowBitsに16を加えると、zlibではなくgzipのヘッダ/フッタで出力される.
+		if (deflateInit2(zStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			delete zStream;
+			fclose(fp);
+			remove(filePath.c_str());
+			return false;
+		}
+	}
+
+	Close();
+	m_fp = fp;
+	if (m_buffer.size() < RIB_WRITER_BUFFER_SIZE) m_buffer.resize(RIB_WRITER_BUFFER_SIZE);
+	if (zStream) {
+		m_zStream = zStream;
+		m_zBuffer.resize(RIB_WRITER_ZBUFFER_SIZE);
+	}
+	return true;
+}
+
+/**
+ * 出力を終了.
+ */
+bool CRIBWriter::Close ()
+{
+	CommitDeferred(0);
+	m_FlushBuffer();
+
+	if (m_zStream) {
+		m_WriteCompressed(NULL, 0, true);
+		deflateEnd(m_zStream);
+		delete m_zStream;
+		m_zStream = NULL;
+		m_zBuffer.clear();
+	}
+	if (m_fp) {
+		if (fclose(m_fp) != 0) m_writeError = true;
+		m_fp = NULL;
+	}
+	return !m_writeError;
+}
+
+/**
+ * バッファが不足する場合の書き出し/拡張.
+ */
+void CRIBWriter::m_Grow (const size_t size)
+{
+	m_FlushBuffer();
+	if (m_bufferPos + size > m_buffer.size()) m_buffer.resize(std::max(m_buffer.size() * 2, m_bufferPos + size));
+}
+
+/**
+ * インデントを出力.
+ */
+void CRIBWriter::m_PutIndent (const int indent)
+{
+	if (indent <= 0) return;
+	if (indent >= (int)m_indentTexts.size()) {
+		const int cou = (int)m_indentTexts.size();
+		m_indentTexts.resize(indent + 1);
+		for (int i = cou; i <= indent; ++i) m_indentTexts[i] = std::string(i * 2, ' ');
+	}
+	const std::string& str = m_indentTexts[indent];
+	m_PutBytes(str.c_str(), str.length());
+}
+
+/**
+ * ASCII出力時の区切り文字を追加.
+ */
+void CRIBWriter::m_PutSeparator ()
+{
+	if (!m_lineTop) m_PutByte(' ');
+	m_lineTop = false;
+}
+
+/**
+ * バッファに追加.
+ */
+void CRIBWriter::m_PutBytes (const void* data, const size_t size)
+{
+	if (size == 0) return;
+	memcpy(m_Reserve(size), data, size);
+	m_bufferPos += size;
+}
+
+/**
+ * 値をBig endianで指定バイト数分出力.
+ */
+void CRIBWriter::m_PutBigEndian (const unsigned int value, const int bytes)
+{
+	unsigned char* p = (unsigned char *)m_Reserve(bytes);
+	for (int i = bytes - 1; i >= 0; --i) {
+		*p++ = (unsigned char)((value >> (i * 8)) & 0xff);
+	}
+	m_bufferPos += bytes;
+}
+
+/**
+ * 文字列をエンコードして出力.
+ */
+void CRIBWriter::m_PutEncodedString (const std::string& str)
+{
+	const unsigned int len = (unsigned int)str.length();
+	if (len < 16) {
+		m_PutByte(RIB_BIN_SHORT_STRING + len);
+	} else {
+		const int bytes = GetByteCount(len);
+		m_PutByte(RIB_BIN_LONG_STRING + (bytes - 1));
+		m_PutBigEndian(len, bytes);
+	}
+	m_PutBytes(str.c_str(), len);
+}
+
+/**
+ * 整数をエンコードして出力.
+ * 符号付き/符号なしのどちらで解釈されても同じ値になるように、最上位ビットが立たないバイト数を使用する.
+ */
+void CRIBWriter::m_PutEncodedInt (const int value)
+{
+	int bytes = 4;
+	if (value >= 0) {
+		if (value <= 0x7f) bytes = 1;
+		else if (value <= 0x7fff) bytes = 2;
+		else if (value <= 0x7fffff) bytes = 3;
+	}
+	m_PutByte(RIB_BIN_INT + (bytes - 1));
+	m_PutBigEndian((unsigned int)value, bytes);
+}
+
+/**
+ * 数値をテキストで出力.
+ */
+void CRIBWriter::m_PutIntText (const int value)
+{
+	m_bufferPos += RIBWriterUtil::FormatInt(m_Reserve(16), value);
+}
+
+void CRIBWriter::m_PutFloatText (const float value)
+{
+	m_bufferPos += RIBWriterUtil::FormatFloat(m_Reserve(32), value);
+}
+
+void CRIBWriter::m_PutFloatText (const float value, const CRIBFloatPrecision& precision, const int gridDecimals, const double gridUnits)
+{
+	char* buff = m_Reserve(32);
+	if (precision.grid > 0.0f) {
+		const double qv = RIBWriterUtil::Quantize(value, precision.grid, gridDecimals, gridUnits);
+		if (gridDecimals >= 0) {
+			m_bufferPos += RIBWriterUtil::FormatFloatFixed(buff, qv, gridDecimals);
+		} else {
+			m_bufferPos += RIBWriterUtil::FormatFloat(buff, (float)qv);
+		}
+	} else if (precision.decimals > 0) {
+		m_bufferPos += RIBWriterUtil::FormatFloatFixed(buff, (double)value, precision.decimals);
+	} else {
+		m_bufferPos += RIBWriterUtil::FormatFloat(buff, value, precision.significantDigits);
+	}
+}
+
+/**
+ * バッファの内容をstreamに出力.
+ */
+void CRIBWriter::m_FlushBuffer ()
+{
+	if (m_bufferPos == 0) return;
+
+	// 確定待ちの出力がある場合は、その後ろに順番を保持して格納.
+	if (!m_pendingList.empty()) {
+		m_pendingList.push_back(CPendingOutput());
+		m_pendingList.back().data.assign(m_buffer.begin(), m_buffer.begin() + m_bufferPos);
+		m_bufferPos = 0;
+		return;
+	}
+	if (IsMemoryOutput()) return;
+
+	m_WriteData(&(m_buffer[0]), m_bufferPos);
+	m_bufferPos = 0;
+}
+
+/**
+ * 圧縮の有無に応じて出力先に書き出す.
+ */
+void CRIBWriter::m_WriteData (const void* data, const size_t size)
+{
+	if (size == 0) return;
+	if (m_zStream) {
+		m_WriteCompressed(data, size, false);
+	} else {
+		m_WriteOutput(data, size);
+	}
+	m_totalBytes += size;
+}
+
+/**
+ * 出力先(ファイルもしくはstream)に書き出す.
+ */
+void CRIBWriter::m_WriteOutput (const void* data, const size_t size)
+{
+	if (size == 0) return;
+	if (m_fp) {
+		if (fwrite(data, 1, size, m_fp) != size) m_writeError = true;
+	} else if (m_stream) {
+		m_stream->write((int)size, data);
+	}
+}
+
+/**
+ * gzip圧縮して出力先に書き出す.
+ * 入力をすべて消費するまで、圧縮後のバッファ単位で書き出す.
+ */
+void CRIBWriter::m_WriteCompressed (const void* data, const size_t size, const bool finish)
+{
+	m_zStream->next_in  = (Bytef *)data;
+	m_zStream->avail_in = (uInt)size;
+
+	const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+	while (true) {
+		m_zStream->next_out  = &(m_zBuffer[0]);
+		m_zStream->avail_out = (uInt)m_zBuffer.size();
+		const int ret = deflate(m_zStream, flush);
+		m_WriteOutput(&(m_zBuffer[0]), m_zBuffer.size() - m_zStream->avail_out);
+		if (ret == Z_STREAM_ERROR) {
+			m_writeError = true;
+			break;
+		}
+
+		if (finish) {
+			if (ret == Z_STREAM_END) break;
+		} else {
+			if (m_zStream->avail_in == 0 && m_zStream->avail_out != 0) break;
+		}
+	}
+}
+
+/**
+ * 1行分の出力.
+ * バイナリ形式の場合も、リクエスト以外はASCIIのまま混在させる.
+ */
+void CRIBWriter::WriteLine (const int indent, const std::string& str)
+{
+	m_PutIndent(indent);
+	m_PutBytes(str.c_str(), str.length());
+	m_PutByte('\n');
+	m_lineTop = true;
+}
+
+/**
+ * リクエスト単位での出力の開始.
+ */
+void CRIBWriter::BeginLine (const int indent)
+{
+	m_lineTop = true;
+	if (!IsBinary()) m_PutIndent(indent);
+}
+
+/**
+ * リクエスト単位での出力の終了.
+ */
+void CRIBWriter::EndLine ()
+{
+	m_PutByte('\n');
+	m_lineTop = true;
+}
+
+/**
+ * リクエスト名を出力.
+ */
+void CRIBWriter::WriteRequest (const char* name)
+{
+	if (!IsBinary()) {
+		m_PutSeparator();
+		m_PutBytes(name, strlen(name));
+		return;
+	}
+
+	std::map<std::string, int>::iterator it = m_requestCodes.find(name);
+	int code = -1;
+	if (it != m_requestCodes.end()) {
+		code = it->second;
+	} else if ((int)m_requestCodes.size() < RIB_BIN_MAX_REQUESTS) {
+		code = (int)m_requestCodes.size();
+		m_requestCodes[name] = code;
+		m_PutByte(RIB_BIN_DEFINE_REQUEST);
+		m_PutByte((unsigned char)code);
+		m_PutEncodedString(name);
+	}
+
+	if (code >= 0) {
+		m_PutByte(RIB_BIN_REQUEST);
+		m_PutByte((unsigned char)code);
+	} else {
+		// 定義数を超えた場合はASCIIで出力.
+		m_PutByte(' ');
+		m_PutBytes(name, strlen(name));
+		m_PutByte(' ');
+	}
+}
+
+/**
+ * 文字列を出力.
+ */
+void CRIBWriter::WriteString (const std::string& str, const bool useToken)
+{
+	if (!IsBinary()) {
+		m_PutSeparator();
+		m_PutByte('"');
+		m_PutBytes(str.c_str(), str.length());
+		m_PutByte('"');
+		return;
+	}
+
+	if (useToken) {
+		std::map<std::string, int>::iterator it = m_stringTokens.find(str);
+		int token = -1;
+		if (it != m_stringTokens.end()) {
+			token = it->second;
+		} else if ((int)m_stringTokens.size() < RIB_BIN_MAX_STRING_TOKENS) {
+			token = (int)m_stringTokens.size();
+			m_stringTokens[str] = token;
+			const int bytes = (token <= 0xff) ? 1 : 2;
+			m_PutByte(RIB_BIN_DEFINE_STRING + (bytes - 1));
+			m_PutBigEndian((unsigned int)token, bytes);
+			m_PutEncodedString(str);
+		}
+		if (token >= 0) {
+			const int bytes = (token <= 0xff) ? 1 : 2;
+			m_PutByte(RIB_BIN_STRING_TOKEN + (bytes - 1));
+			m_PutBigEndian((unsigned int)token, bytes);
+			return;
+		}
+	}
+	m_PutEncodedString(str);
+}
+
+/**
+ * 文字列の配列を出力.
+ */
+void CRIBWriter::WriteStringArray (const std::vector<std::string>& strList, const bool useToken)
+{
+	if (!IsBinary()) m_PutSeparator();
+	m_PutByte('[');
+	m_lineTop = true;
+	for (size_t i = 0; i < strList.size(); ++i) WriteString(strList[i], useToken);
+	m_PutByte(']');
+	m_lineTop = false;
+}
+
+/**
+ * 整数の配列を出力.
+ */
+void CRIBWriter::WriteIntArray (const int* values, const int count)
+{
+	BeginIntArray();
+	AppendIntArray(values, count);
+	EndArray();
+}
+
+/**
+ * 実数の配列を出力.
+ */
+void CRIBWriter::WriteFloatArray (const float* values, const int count)
+{
+	BeginFloatArray(count);
+	AppendFloatArray(values, count);
+	EndArray();
+}
+
+/**
+ * 精度を指定して実数の配列を出力.
+ */
+void CRIBWriter::WriteFloatArray (const float* values, const int count, const CRIBFloatPrecision& precision)
+{
+	BeginFloatArray(count);
+	AppendFloatArray(values, count, precision);
+	EndArray();
+}
+
+/**
+ * 整数の配列の出力開始.
+ * Binary encodingには整数の配列がないため、"[" "]"で囲んだ整数列として出力する.
+ */
+void CRIBWriter::BeginIntArray ()
+{
+	if (!IsBinary()) m_PutSeparator();
+	m_PutByte('[');
+	m_arrayType = rib_array_int;
+}
+
+/**
+ * 実数の配列の出力開始.
+ * バイナリ形式の場合は、要素数を先頭に出力する.
+ */
+void CRIBWriter::BeginFloatArray (const int count)
+{
+	if (!IsBinary()) {
+		m_PutSeparator();
+		m_PutByte('[');
+	} else {
+		const int bytes = GetByteCount((unsigned int)count);
+		m_PutByte(RIB_BIN_FLOAT_ARRAY + (bytes - 1));
+		m_PutBigEndian((unsigned int)count, bytes);
+	}
+	m_arrayType = rib_array_float;
+}
+
+/**
+ * 配列の要素を追加.
+ */
+void CRIBWriter::AppendIntArray (const int* values, const int count)
+{
+	if (!IsBinary()) {
+		for (int i = 0; i < count; ++i) {
+			m_PutByte(' ');
+			m_PutIntText(values[i]);
+		}
+		return;
+	}
+	for (int i = 0; i < count; ++i) m_PutEncodedInt(values[i]);
+}
+
+/**
+ * 配列の要素を追加.
+ * バイナリ形式の場合は、IEEEの単精度浮動小数点数をBig endianで出力する (精度は量子化のみ反映).
+ */
+void CRIBWriter::AppendFloatArray (const float* values, const int count, const CRIBFloatPrecision& precision)
+{
+	double gridUnits = 0.0;
+	const bool quantize = (precision.grid > 0.0f);
+	const int gridDecimals = quantize ? RIBWriterUtil::GetGridDecimals(precision.grid, gridUnits) : -1;
+
+	if (!IsBinary()) {
+		const bool useDefault = precision.IsDefault();
+		for (int i = 0; i < count; ++i) {
+			m_PutByte(' ');
+			if (useDefault) m_PutFloatText(values[i]);
+			else m_PutFloatText(values[i], precision, gridDecimals, gridUnits);
+		}
+		return;
+	}
+
+	unsigned int iv;
+	for (int i = 0; i < count; ++i) {
+		const float v = quantize ? (float)RIBWriterUtil::Quantize(values[i], precision.grid, gridDecimals, gridUnits) : values[i];
+		memcpy(&iv, &v, sizeof(float));
+		m_PutBigEndian(iv, 4);
+	}
+}
+
+/**
+ * 配列の出力終了.
+ */
+void CRIBWriter::EndArray ()
+{
+	if (!IsBinary()) {
+		m_PutBytes(" ]", 2);
+	} else if (m_arrayType == rib_array_int) {
+		m_PutByte(']');
+	}
+	m_arrayType = rib_array_none;
+}
+
+/**
+ * メモリ上に出力した内容を取得.
+ */
+void CRIBWriter::GetData (std::vector<char>& data)
+{
+	data.assign(m_buffer.begin(), m_buffer.begin() + m_bufferPos);
+}
+
+/**
+ * 後から確定する出力を、現在の位置に追加.
+ */
+void CRIBWriter::AppendDeferred (const std::shared_ptr<CRIBDeferredOutput>& deferred)
+{
+	m_FlushBuffer();
+
+	m_pendingList.push_back(CPendingOutput());
+	m_pendingList.back().deferred = deferred;
+	m_deferredCount++;
+
+	// 埋め込まれる出力側でリクエストや文字列のトークンが定義し直されるため、以降は再定義する.
+	m_requestCodes.clear();
+	m_stringTokens.clear();
+	m_lineTop = true;
+}
+
+/**
+ * 確定した出力を順番に書き出す.
+ */
+void CRIBWriter::CommitDeferred (const int maxDeferredCount)
+{
+	if (m_pendingList.empty()) return;
+	m_FlushBuffer();
+
+	while (!m_pendingList.empty()) {
+		CPendingOutput& pending = m_pendingList.front();
+		if (pending.deferred) {
+			if (!pending.deferred->IsDone()) {
+				if (m_deferredCount <= maxDeferredCount) break;
+				pending.deferred->Wait();
+			}
+			const std::vector<char>& data = pending.deferred->GetOutput();
+			if (!data.empty()) m_WriteData(&(data[0]), data.size());
+			const std::string error = pending.deferred->GetError();
+			if (!error.empty()) m_deferredErrors.push_back(error);
+			m_deferredCount--;
+		} else {
+			if (!pending.data.empty()) m_WriteData(&(pending.data[0]), pending.data.size());
+		}
+		m_pendingList.pop_front();
+	}
+}
+
+/**
+ * 書き出した確定待ちの出力のうち、作成に失敗したもののエラー内容を取得して空にする.
+ */
+bool CRIBWriter::TakeDeferredErrors (std::vector<std::string>& retErrors)
+{
+	retErrors.clear();
+	retErrors.swap(m_deferredErrors);
+	return !retErrors.empty();
+}
+
+/**
+ * 出力を確定.
+ * gzip圧縮中の場合は、圧縮器の内部に残っている分は終了時に書き出される.
+ */
+void CRIBWriter::Flush ()
+{
+	CommitDeferred(0);
+	m_FlushBuffer();
+	if (m_fp) fflush(m_fp);
+}
@@ -0,0 +1,358 @@
+﻿/**
+ * RIBの出力クラス.
+ * ASCII形式と、RenderManのBinary encodingでの出力を切り替える.
+ * 出力はバッファに追記し、一定サイズごとにまとめてstreamに書き出す.
+ */
+
+#ifndef _RIBWRITER_H
+#define _RIBWRITER_H
+
+#include "GlobalHeader.h"
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <stdio.h>
+
+struct z_stream_s;
+
+/**
+ * 別スレッドなどで後から確定する出力.
+ * CRIBWriter::AppendDeferredで、追加した位置に出力内容が埋め込まれる.
+ */
+class CRIBDeferredOutput
+{
+public:
+	virtual ~CRIBDeferredOutput () { }
+
+	/**
+	 * 出力内容が確定しているか.
+	 */
+	virtual bool IsDone () = 0;
+
+	/**
+	 * 出力内容が確定するまで待つ.
+	 */
+	virtual void Wait () = 0;
+
+	/**
+	 * 確定した出力内容を取得.
+	 */
+	virtual const std::vector<char>& GetOutput () const = 0;
+
+	/**
+	 * 出力内容を作成できなかった場合のエラー内容を取得 (成功した場合は空).
+	 */
+	virtual std::string GetError () const { return ""; }
+};
+
+/**
+ * 実数の配列を出力する際の精度.
+ * grid、decimals、significantDigitsの順に優先する.
+ */
+class CRIBFloatPrecision
+{
+public:
+	int significantDigits;		// 有効桁数 (0の場合は、読み戻して同じ値になる最短の桁数).
+	int decimals;				// 小数点以下の桁数 (0の場合は使用しない).
+	float grid;					// 量子化の間隔 (0の場合は量子化しない). 出力値と元の値の差はgrid/2以下になる.
+
+public:
+	CRIBFloatPrecision (const int significantDigits = 0, const int decimals = 0, const float grid = 0.0f) {
+		this->significantDigits = significantDigits;
+		this->decimals          = decimals;
+		this->grid              = grid;
+	}
+
+	/**
+	 * 精度を指定していない (最短の桁数で出力する) か.
+	 */
+	bool IsDefault () const { return (significantDigits <= 0 && decimals <= 0 && grid <= 0.0f); }
+};
+
+class CRIBWriter
+{
+private:
+	/**
+	 * 確定待ちの出力がある場合に、順番を保持するための出力単位.
+	 */
+	class CPendingOutput
+	{
+	public:
+		std::vector<char> data;									// 出力済みの内容.
+		std::shared_ptr<CRIBDeferredOutput> deferred;			// 確定待ちの出力 (NULLの場合はdataを使用).
+	};
+
+	sxsdk::stream_interface* m_stream;
+	FILE* m_fp;										// ファイルに出力する場合のファイルポインタ.
+	z_stream_s* m_zStream;							// gzip圧縮する場合の圧縮情報.
+	std::vector<unsigned char> m_zBuffer;			// 圧縮後のデータの出力バッファ.
+
+	RIBParam::RIB_ENCODING_TYPE m_encoding;			// 出力形式.
+
+	std::vector<char> m_buffer;						// 出力バッファ.
+	size_t m_bufferPos;								// バッファの使用サイズ.
+	size_t m_totalBytes;							// 出力済みのバイト数.
+
+	bool m_lineTop;									// 行の先頭の場合はtrue.
+	std::vector<std::string> m_indentTexts;			// インデントごとのスペースのキャッシュ.
+
+	std::map<std::string, int> m_requestCodes;		// 定義済みのリクエストと番号.
+	std::map<std::string, int> m_stringTokens;		// 定義済みの文字列とトークン番号.
+
+	std::deque<CPendingOutput> m_pendingList;		// 確定待ちの出力を含む、書き出し待ちの出力.
+	int m_deferredCount;							// 確定待ちの出力数.
+	std::vector<std::string> m_deferredErrors;		// 書き出した確定待ちの出力のうち、作成に失敗したもののエラー内容.
+	bool m_writeError;								// ファイルへの書き込みや圧縮に失敗した場合はtrue.
+
+	/**
+	 * 分割して出力中の配列の種類.
+	 */
+	enum RIB_ARRAY_TYPE {
+		rib_array_none = 0,
+		rib_array_int,
+		rib_array_float,
+	};
+	RIB_ARRAY_TYPE m_arrayType;						// 出力中の配列の種類.
+
+	/**
+	 * 指定サイズを書き込めるバッファ位置を取得.
+	 * 確保後、m_bufferPosを書き込んだサイズ分進めること.
+	 */
+	inline char* m_Reserve (const size_t size) {
+		if (m_bufferPos + size > m_buffer.size()) m_Grow(size);
+		return &(m_buffer[m_bufferPos]);
+	}
+
+	/**
+	 * バッファが不足する場合の書き出し/拡張.
+	 */
+	void m_Grow (const size_t size);
+
+	/**
+	 * インデントを出力.
+	 */
+	void m_PutIndent (const int indent);
+
+	/**
+	 * ASCII出力時の区切り文字を追加.
+	 */
+	void m_PutSeparator ();
+
+	/**
+	 * バッファに追加.
+	 */
+	inline void m_PutByte (const unsigned char c) {
+		*m_Reserve(1) = (char)c;
+		m_bufferPos++;
+	}
+	void m_PutBytes (const void* data, const size_t size);
+
+	/**
+	 * 値をBig endianで指定バイト数分出力.
+	 */
+	void m_PutBigEndian (const unsigned int value, const int bytes);
+
+	/**
+	 * 文字列をエンコードして出力.
+	 */
+	void m_PutEncodedString (const std::string& str);
+
+	/**
+	 * 整数をエンコードして出力.
+	 */
+	void m_PutEncodedInt (const int value);
+
+	/**
+	 * 数値をテキストで出力.
+	 */
+	void m_PutIntText (const int value);
+	void m_PutFloatText (const float value);
+
+	/**
+	 * 精度を指定して実数をテキストで出力.
+	 * @param[in] gridDecimals  量子化の間隔を10進数で表す場合の小数点以下の桁数 (RIBWriterUtil::GetGridDecimals).
+	 * @param[in] gridUnits     量子化の間隔を10^gridDecimals倍した整数値.
+	 */
+	void m_PutFloatText (const float value, const CRIBFloatPrecision& precision, const int gridDecimals, const double gridUnits);
+
+	/**
+	 * バッファの内容をstreamに出力.
+	 */
+	void m_FlushBuffer ();
+
+	/**
+	 * 圧縮の有無に応じて出力先に書き出す.
+	 */
+	void m_WriteData (const void* data, const size_t size);
+
+	/**
+	 * 出力先(ファイルもしくはstream)に書き出す.
+	 */
+	void m_WriteOutput (const void* data, const size_t size);
+
+	/**
+	 * gzip圧縮して出力先に書き出す.
+	 * @param[in] finish  trueの場合は圧縮を終了する.
+	 */
+	void m_WriteCompressed (const void* data, const size_t size, const bool finish);
+
+public:
+	CRIBWriter (sxsdk::stream_interface* stream, const RIBParam::RIB_ENCODING_TYPE encoding);
+	~CRIBWriter ();
+
+	/**
+	 * streamとファイルのどちらにも出力しない場合は、メモリ上に出力する (GetDataで取得).
+	 */
+	bool IsMemoryOutput () const { return (m_stream == NULL && m_fp == NULL); }
+
+	/**
+	 * メモリ上に出力した内容を取得.
+	 */
+	void GetData (std::vector<char>& data);
+
+	/**
+	 * 後から確定する出力を、現在の位置に追加.
+	 * 以降の出力は、確定待ちの出力がすべて書き出されるまでメモリ上に保持される.
+	 */
+	void AppendDeferred (const std::shared_ptr<CRIBDeferredOutput>& deferred);
+
+	/**
+	 * 確定した出力を順番に書き出す.
+	 * @param[in] maxDeferredCount  確定待ちの出力がこの数以下になるまで待つ.
+	 */
+	void CommitDeferred (const int maxDeferredCount);
+
+	/**
+	 * 書き出した確定待ちの出力のうち、作成に失敗したもののエラー内容を取得して空にする.
+	 * @return エラーがある場合はtrue.
+	 */
+	bool TakeDeferredErrors (std::vector<std::string>& retErrors);
+
+	/**
+	 * 出力先をファイルに切り替える.
+	 * それまでにバッファにある内容は、切り替え前の出力先に書き出される.
+	 * @param[in] filePath  ファイルのフルパス.
+	 * @param[in] compress  gzip圧縮して出力する場合はtrue (.rib.gz).
+	 * @return ファイルを開けなかった場合、圧縮を開始できなかった場合はfalse (出力先は変更しない).
+	 */
+	bool Open (const std::string& filePath, const bool compress);
+
+	/**
+	 * 出力を終了.
+	 * ファイルに出力している場合は、圧縮を終了してファイルを閉じる.
+	 * @return これまでにファイルへの書き込みや圧縮に失敗していた場合はfalse (ディスクの容量不足など).
+	 */
+	bool Close ();
+
+	/**
+	 * バイナリ形式で出力するか.
+	 */
+	bool IsBinary () const { return (m_encoding == RIBParam::rib_binary); }
+
+	/**
+	 * 出力したバイト数を取得.
+	 */
+	size_t GetTotalBytes () const { return m_totalBytes + m_bufferPos; }
+
+	/**
+	 * 1行分の出力.
+	 */
+	void WriteLine (const int indent, const std::string& str);
+
+	/**
+	 * リクエスト単位での出力の開始/終了.
+	 * バイナリ形式の場合はインデントは出力しない.
+	 */
+	void BeginLine (const int indent);
+	void EndLine ();
+
+	/**
+	 * リクエスト名を出力 (PointsPolygonsなど).
+	 */
+	void WriteRequest (const char* name);
+
+	/**
+	 * 文字列を出力.
+	 * @param[in] str       文字列.
+	 * @param[in] useToken  バイナリ形式の場合に、文字列をトークンとして定義して再利用する.
+	 */
+	void WriteString (const std::string& str, const bool useToken = false);
+
+	/**
+	 * 文字列の配列を出力.
+	 */
+	void WriteStringArray (const std::vector<std::string>& strList, const bool useToken = false);
+
+	/**
+	 * 整数の配列を出力.
+	 */
+	void WriteIntArray (const int* values, const int count);
+
+	/**
+	 * 実数の配列を出力.
+	 */
+	void WriteFloatArray (const float* values, const int count);
+
+	/**
+	 * 精度を指定して実数の配列を出力.
+	 * バイナリ形式の場合は、量子化のみ行う.
+	 */
+	void WriteFloatArray (const float* values, const int count, const CRIBFloatPrecision& precision);
+
+	/**
+	 * 配列を分割して出力.
+	 * Begin*Arrayで開始し、Append*Arrayで要素を追加後にEndArrayで閉じる.
+	 * 実数の配列は、バイナリ形式では要素数を先頭に出力するため、開始時に全体の要素数を指定すること.
+	 */
+	void BeginIntArray ();
+	void BeginFloatArray (const int count);
+	void AppendIntArray (const int* values, const int count);
+	void AppendFloatArray (const float* values, const int count, const CRIBFloatPrecision& precision = CRIBFloatPrecision());
+	void EndArray ();
+
+	/**
+	 * 出力を確定.
+	 */
+	void Flush ();
+};
+
+namespace RIBWriterUtil
+{
+	/**
+	 * 整数をテキストに変換.
+	 * @param[out] buff  出力先 (12バイト以上).
+	 * @return 文字数.
+	 */
+	int FormatInt (char* buff, const int value);
+
+	/**
+	 * 実数を、読み戻して同じ値になる最短の桁数でテキストに変換.
+	 * @param[out] buff               出力先 (24バイト以上).
+	 * @param[in]  significantDigits  有効桁数 (1-9)。0の場合は最短の桁数.
+	 * @return 文字数.
+	 */
+	int FormatFloat (char* buff, const float value, const int significantDigits = 0);
+
+	/**
+	 * 実数を、小数点以下の桁数を指定してテキストに変換 (末尾の0はカット).
+	 * @param[out] buff      出力先 (32バイト以上).
+	 * @param[in]  decimals  小数点以下の桁数 (0-9).
+	 * @return 文字数.
+	 */
+	int FormatFloatFixed (char* buff, const double value, const int decimals);
+
+	/**
+	 * 量子化の間隔を、10進数の整数 gridUnits * 10^-decimals として表す場合の桁数を取得.
+	 * @param[out] gridUnits  間隔を10^decimals倍した整数値.
+	 * @return 小数点以下の桁数 (0-9)。9桁以内で表せない場合は-1.
+	 */
+	int GetGridDecimals (const float grid, double& gridUnits);
+
+	/**
+	 * 値を量子化の間隔の倍数に丸める.
+	 */
+	double Quantize (const float value, const float grid, const int gridDecimals, const double gridUnits);
+}
+
+#endif
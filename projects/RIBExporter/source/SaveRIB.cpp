@@ -20,6 +20,8 @@
 
 #define BACKGROUND_TEXTURE_NAME "background_panorama"		// 背景画像の名前.
 
+#define GEOMETRY_CACHE_FILE_NAME "geometry_cache.txt"		// 形状アーカイブのキャッシュ情報のファイル名.
+
 namespace {
 	// sxsdk::rgb_classの色が(0, 0, 0)であるか判定.
 	bool CheckColorBlack (const sxsdk::rgb_class& col) {
@@ -67,7 +69,7 @@ void CRIBInfo::Clear ()
 //-----------------------------------------------------------.
 
 CSaveRIB::CSaveRIB (sxsdk::shade_interface& shade, sxsdk::stream_interface* stream, sxsdk::text_stream_interface* text_stream, const RIBExportData& dlgData) :
-	shade(shade), m_stream(stream), m_text_stream(text_stream), m_polygonMeshCtrl(shade), m_lightCtrl(shade), m_dlgData(dlgData)
+	shade(shade), m_stream(stream), m_text_stream(text_stream), m_writer(stream, dlgData.ribEncoding), m_lightCtrl(shade), m_dlgData(dlgData)
 {
 	m_RIBInfo.ribFileName = Util::GetFileNameToStream(m_stream);
 	m_RIBInfo.filePath    = Util::GetFilePath(m_stream);
@@ -105,6 +107,22 @@ CSaveRIB::CSaveRIB (sxsdk::shade_interface& shade, sxsdk::stream_interface* stre
 	}
 
 	m_indent = 0;
+	m_pThreadPool = NULL;
+	m_isInstanceMesh = false;
+	m_isLocalSpaceMesh = false;
+	m_pProfiler = NULL;
+	m_traverseStartTime = 0;
+	m_culledShapesCount = 0;
+	m_outputFailed = false;
+	m_meshStoreStartTime = 0;
+	m_meshShapeID = -1;
+}
+
+CSaveRIB::~CSaveRIB ()
+{
+	// 処理中の出力があるため、先にスレッドを終了する.
+	if (m_pThreadPool) delete m_pThreadPool;
+	m_pThreadPool = NULL;
 }
 
 /**
@@ -116,9 +134,9 @@ void CSaveRIB::m_WriteHeader ()
 	{
 		std::stringstream s;
 		s << "# " << m_RIBInfo.ribFileName;
-		m_text_stream->write_line(s.str().c_str());
-		m_text_stream->write_line("#");
-		m_text_stream->write_line("");
+		m_WriteLine(s.str());
+		m_WriteLine("#");
+		m_WriteLine("");
 	}
 
 	// Display.
@@ -136,14 +154,14 @@ void CSaveRIB::m_WriteHeader ()
 			s << " \"rgba\"";
 		}
 
-		m_text_stream->write_line(s.str().c_str());
+		m_WriteLine(s.str());
 	}
 
 #if !USE_PRMAN_RIS
 	if (!m_outputExr) {
 		std::stringstream s;
 		s << "Exposure 1.0 2.2";		// Gain gammaの指定.
-		m_text_stream->write_line(s.str().c_str());
+		m_WriteLine(s.str());
 	}
 #endif
 
@@ -152,7 +170,7 @@ void CSaveRIB::m_WriteHeader ()
 	{
 		std::stringstream s;
 		s << "Hider \"zbuffer\"";
-		m_text_stream->write_line(s.str().c_str());
+		m_WriteLine(s.str());
 	}
 #endif
 
@@ -160,14 +178,14 @@ void CSaveRIB::m_WriteHeader ()
 	{
 		std::stringstream s;
 		s << "Format " << m_RIBInfo.renderingImageSize.x << " " << m_RIBInfo.renderingImageSize.y << " 1";
-		m_text_stream->write_line(s.str().c_str());
+		m_WriteLine(s.str());
 	}
 
 	// Projection.
 	{
 		std::stringstream s;
 		s << "Projection \"perspective\" " << "\"fov\" [" << m_RIBInfo.fov << "]";
-		m_text_stream->write_line(s.str().c_str());
+		m_WriteLine(s.str());
 	}
 
 	//-----------------------------------------.
@@ -391,17 +409,6 @@ void CSaveRIB::SetSceneInfo (sxsdk::scene_interface* scene)
 	m_RIBInfo.renderingImageSize = cameraCtrl.GetRenderingImageSize();		// レンダリング画像サイズを取得.
 }
 
-/**
- * インデントからスペースを取得.
- */
-std::string CSaveRIB::m_IndentToText (const int indent)
-{
-	std::string str = "";
-	for (int i = 0; i < indent; ++i) str += "  ";
-
-	return str;
-}
-
 /**
  * エクスポート開始.
  */
@@ -409,11 +416,21 @@ void CSaveRIB::BeginExport (sxsdk::scene_interface* scene)
 {
 	m_pScene = scene;
 
+	m_profiler.Clear();
+	m_pProfiler = m_dlgData.profileExport ? &m_profiler : NULL;
+	m_meshShapeID = -1;
+
 	// テクスチャを出力.
-	m_OutputTextureFiles(scene);
+	{
+		CExportProfiler::CScope scope(m_pProfiler, "Output Textures", "phase");
+		m_OutputTextureFiles(scene);
+	}
 
 	// 背景画像を出力.
-	m_OutputBackgroundTextureFile(scene);
+	{
+		CExportProfiler::CScope scope(m_pProfiler, "Output Background Texture", "phase");
+		m_OutputBackgroundTextureFile(scene);
+	}
 
 	{
 		int textureCou = 0;
@@ -443,15 +460,58 @@ void CSaveRIB::BeginExport (sxsdk::scene_interface* scene)
 	}
 
 	m_indent = 0;
+	m_geometryArchiveNames.clear();
+	m_objectInstances.clear();
+	m_objectInstanceNames.clear();
+	if (m_dlgData.geometryArchive) {
+		m_geometryCache.Load(m_RIBInfo.filePath, m_RIBInfo.filePath + "/geometry/" + GEOMETRY_CACHE_FILE_NAME);
+	}
+
+	// 遠くの形状を簡略化する場合は、カメラ位置と、カメラからの距離1での1単位あたりのピクセル数を計算.
+	// RenderManのfovは画像の短辺に対する視野角.
+	m_lodParam = CMeshLODParam();
+	if (m_dlgData.lodDecimation && m_dlgData.lodPixelSize > 0.0f && m_RIBInfo.perspective) {
+		sxsdk::mat4 viewToWorldMatrix;
+		const int imageSize     = std::min(m_RIBInfo.renderingImageSize.x, m_RIBInfo.renderingImageSize.y);
+		const float tanHalfFov  = std::tan(m_RIBInfo.fov * 0.5f * sx::pi / 180.0f);
+		if (imageSize > 0 && tanHalfFov > 0.0f && MathUtil::InverseMatrix(m_RIBInfo.worldToViewMatrix, viewToWorldMatrix)) {
+			m_lodParam.cameraPosition = sxsdk::vec3(0, 0, 0) * viewToWorldMatrix;
+			m_lodParam.pixelsPerUnit  = (float)imageSize / (2.0f * tanHalfFov);
+			m_lodParam.targetPixels   = m_dlgData.lodPixelSize;
+		}
+	}
+
+	// カメラの視野外の形状を除外する場合は、視錐台を計算.
+	m_viewFrustum.Clear();
+	m_culledShapesCount = 0;
+	m_outputFailed = false;
+	if (m_dlgData.frustumCulling && m_RIBInfo.perspective) {
+		m_viewFrustum.Set(m_RIBInfo.worldToViewMatrix, m_RIBInfo.fov, m_RIBInfo.renderingImageSize, m_dlgData.cullMargin, m_dlgData.cullKeepRadius);
+	}
+
+	// 形状の出力処理を行うスレッド (形状の走査はメインスレッドで行うため、1つ少なくする).
+	if (m_dlgData.parallelOutput && !m_dlgData.streamingOutput && !m_pThreadPool) {
+		const int threadCou = CThreadPool::GetHardwareThreadCount() - 1;
+		if (threadCou > 0) m_pThreadPool = new CThreadPool(threadCou);
+	}
+
+	// gzip圧縮する場合は、圧縮したRIBを別ファイルに出力してReadArchiveで参照する.
+	if (m_dlgData.ribCompress) m_OpenCompressedRIB();
 
 	// ヘッダ情報を出力.
-	m_WriteHeader();
+	{
+		CExportProfiler::CScope scope(m_pProfiler, "Write Header", "phase");
+		m_WriteHeader();
 
-	// テクスチャの参照を出力.
-	m_WriteTextures();
+		// テクスチャの参照を出力.
+		m_WriteTextures();
+	}
 
 	// マスターサーフェスとしてのマテリアル情報を出力.
-	m_WriteMasterSurfaceMaterials(scene);
+	{
+		CExportProfiler::CScope scope(m_pProfiler, "Write Master Surface Materials", "phase");
+		m_WriteMasterSurfaceMaterials(scene);
+	}
 
 	// カメラの変換を出力.
 	m_WriteCamera();
@@ -473,16 +533,131 @@ void CSaveRIB::BeginExport (sxsdk::scene_interface* scene)
 	}
 
 	// 光源の出力.
-	m_WriteLights(scene);
+	{
+		CExportProfiler::CScope scope(m_pProfiler, "Write Lights", "phase");
+		m_WriteLights(scene);
+	}
+
+	if (m_pProfiler) m_traverseStartTime = m_pProfiler->GetTime();
 }
 
 /**
  * エクスポート終了.
  */
-void CSaveRIB::EndExport ()
+bool CSaveRIB::EndExport ()
+{
+	if (m_pProfiler) {
+		m_pProfiler->AddEvent("Traverse Shapes", "phase", m_traverseStartTime, m_pProfiler->GetTime() - m_traverseStartTime);
+	}
+
+	{
+		// 処理待ちの形状の出力もここで待つ.
+		CExportProfiler::CScope scope(m_pProfiler, "Finish Output", "phase");
+
+		m_indent--;
+		m_WriteLine("WorldEnd");
+
+		if (!m_writer.Close()) {
+			m_outputFailed = true;
+			shade.message("Failed to write the RIB file.");
+		}
+		m_ReportDeferredErrors();
+
+		if (m_pThreadPool) {
+			delete m_pThreadPool;
+			m_pThreadPool = NULL;
+		}
+
+		// 再利用のために保持していた領域を解放.
+		m_polygonMeshCtrlPool.clear();
+		m_meshScratchPool.Clear();
+	}
+
+	// 形状アーカイブのキャッシュ情報を保存.
+	if (m_dlgData.geometryArchive) {
+		m_geometryCache.Save();
+
+		std::stringstream s;
+		s << "[ geometry archives ] written : " << m_geometryCache.GetWrittenCount() << "  reused : " << m_geometryCache.GetReusedCount();
+		shade.message(s.str().c_str());
+	}
+
+	if (m_viewFrustum.IsEnabled()) {
+		std::stringstream s;
+		s << "[ frustum culling ] culled shapes : " << m_culledShapesCount;
+		shade.message(s.str().c_str());
+	}
+
+	if (m_pProfiler) m_OutputProfile();
+
+	return !m_outputFailed;
+}
+
+/**
+ * 形状の出力処理でのエラーを表示し、エクスポートを失敗とする.
+ */
+void CSaveRIB::m_ReportOutputError (const std::string& error)
 {
-	m_indent--;
-	m_WriteLine("WorldEnd");
+	m_outputFailed = true;
+	shade.message(("Failed to output the shape. " + error).c_str());
+}
+
+/**
+ * 書き出した確定待ちの出力のうち、作成に失敗したもののエラーを表示.
+ */
+void CSaveRIB::m_ReportDeferredErrors ()
+{
+	std::vector<std::string> errors;
+	if (!m_writer.TakeDeferredErrors(errors)) return;
+	for (size_t i = 0; i < errors.size(); ++i) m_ReportOutputError(errors[i]);
+}
+
+/**
+ * 計測結果を表示し、指定されている場合はファイルに保存.
+ * ファイル名は、RIBファイル名の拡張子を "_profile.json" にしたもの.
+ */
+void CSaveRIB::m_OutputProfile ()
+{
+	std::vector<std::string> lines;
+	m_profiler.GetSummary(lines);
+	for (size_t i = 0; i < lines.size(); ++i) shade.message(lines[i].c_str());
+
+	if (m_dlgData.profileTrace) {
+		std::string name = m_RIBInfo.ribFileName;
+		const int iPos = name.find(".");
+		if (iPos != std::string::npos) name = name.substr(0, iPos);
+		name += "_profile.json";
+
+		if (m_profiler.SaveTrace(m_RIBInfo.filePath + "/" + name)) {
+			shade.message(("  trace : " + name).c_str());
+		} else {
+			shade.message("Failed to save the profile file.");
+		}
+	}
+}
+
+/**
+ * gzip圧縮したRIBファイル(.rib.gz)に出力先を切り替える.
+ * エクスポート先のRIBファイルには、圧縮したRIBを参照するReadArchiveのみを出力する.
+ */
+void CSaveRIB::m_OpenCompressedRIB ()
+{
+	std::string name = m_RIBInfo.ribFileName;
+	const int iPos = name.find(".");
+	if (iPos != std::string::npos) name = name.substr(0, iPos);
+	name += ".rib.gz";
+
+	if (!m_writer.Open(m_RIBInfo.filePath + "/" + name, true)) {
+		shade.message("Failed to create the compressed RIB file. Output without compression.");
+		return;
+	}
+
+	m_text_stream->write_line("##RenderMan RIB");
+	{
+		std::stringstream s;
+		s << "ReadArchive \"" << name << "\"";
+		m_text_stream->write_line(s.str().c_str());
+	}
 }
 
 /**
@@ -498,8 +673,7 @@ sxsdk::rgb_class CSaveRIB::m_CalcLinearColor (const sxsdk::rgb_class& col)
  */
 void CSaveRIB::m_WriteLine(const std::string& str)
 {
-	std::string str2 = m_IndentToText(m_indent) + str;
-	m_text_stream->write_line(str2.c_str());
+	m_writer.WriteLine(m_indent, str);
 }
 
 /**
@@ -2506,17 +2680,65 @@ std::string CSaveRIB::m_OutputTexture (sxsdk::scene_interface* scene, sxsdk::sha
 	return "";
 }
 
+/**
+ * 参照する出力処理がすべて完了したポリゴンメッシュ情報を取得 (ない場合は作成).
+ * 小さな形状が多数ある場合に、形状ごとに格納領域を確保/解放しないように再利用する.
+ * プールに保持するのはMESH_POOL_MAX_COUNT個までで、それ以上は使い捨てる.
+ */
+std::shared_ptr<CPolygonMeshCtrl> CSaveRIB::m_AcquirePolygonMeshCtrl ()
+{
+	// 逐次出力の場合は、最後のfaceGroupの出力中に格納したメッシュ情報を解放するため再利用しない.
+	if (m_dlgData.streamingOutput) return std::shared_ptr<CPolygonMeshCtrl>(new CPolygonMeshCtrl(shade));
+
+	// 参照する出力処理がすべて完了している場合は、ワーカースレッドから読まれることはない.
+	m_TrimPolygonMeshCtrlPool();
+	for (size_t i = 0; i < m_polygonMeshCtrlPool.size(); ++i) {
+		if (m_polygonMeshCtrlPool[i].IsFree()) return m_polygonMeshCtrlPool[i].meshCtrl;
+	}
+	std::shared_ptr<CPolygonMeshCtrl> meshCtrl(new CPolygonMeshCtrl(shade));
+	if (m_polygonMeshCtrlPool.size() < MESH_POOL_MAX_COUNT) {
+		m_polygonMeshCtrlPool.push_back(CPolygonMeshPoolEntry());
+		m_polygonMeshCtrlPool.back().meshCtrl = meshCtrl;
+	}
+	return meshCtrl;
+}
+
+/**
+ * プール内の出力処理が終わったポリゴンメッシュ情報のうち、確保済みの領域がMESH_POOL_MAX_BYTESを超えるものを解放.
+ * 大きな形状の格納領域を、エクスポートの終了まで保持し続けないようにする.
+ */
+void CSaveRIB::m_TrimPolygonMeshCtrlPool ()
+{
+	size_t dst = 0;
+	for (size_t i = 0; i < m_polygonMeshCtrlPool.size(); ++i) {
+		CPolygonMeshPoolEntry& entry = m_polygonMeshCtrlPool[i];
+		if (entry.IsFree() && entry.meshCtrl->GetCapacityBytes() > MESH_POOL_MAX_BYTES) continue;
+		if (dst != i) m_polygonMeshCtrlPool[dst] = entry;
+		dst++;
+	}
+	m_polygonMeshCtrlPool.resize(dst);
+}
+
 /**
  * ポリゴンメッシュ情報の格納開始.
  */
-void CSaveRIB::BeginPolygonMesh (sxsdk::shape_class* shape)
+void CSaveRIB::BeginPolygonMesh (sxsdk::shape_class* shape, const sxsdk::mat4& lwMat, const bool instance)
 {
+	m_isInstanceMesh   = instance;
+	m_isLocalSpaceMesh = instance || m_dlgData.localSpaceGeometry;
+	m_meshLWMatrix     = lwMat;
+	m_meshShapeID++;
+	if (m_pProfiler) m_meshStoreStartTime = m_pProfiler->GetTime();
+
 	// Subdivision処理をRenderManに任せる場合は、法線で頂点を増やさない.
 	bool separeteNormal = (m_dlgData.doSubdivision || m_currentSubdivisionType == 0);
 
 	// TODO : UVも連続している必要があるので、separeteNormalでUV/法線での頂点を増やす作業を無効化している.
+	// facevaryingで出力する場合は頂点を増やさないため、Subdivision時もUVの境界を保持できる.
+	const bool facevarying = m_dlgData.facevaryingPrimvars;
 	const std::string name = Util::ReplaceName(std::string(shape->get_name()));
-	m_polygonMeshCtrl.BeginStore(name, separeteNormal, separeteNormal);
+	m_pPolygonMeshCtrl = m_AcquirePolygonMeshCtrl();
+	m_pPolygonMeshCtrl->BeginStore(name, facevarying || separeteNormal, separeteNormal, (m_dlgData.weldTolerance > 0.0f) ? m_dlgData.weldTolerance : 0.0f, facevarying);
 	m_pCurrentShape = shape;
 
 	// Subdivison情報を保持.
@@ -2525,19 +2747,118 @@ void CSaveRIB::BeginPolygonMesh (sxsdk::shape_class* shape)
 		sxsdk::polygon_mesh_class& pmesh = shape->get_polygon_mesh();
 		m_currentSubdivisionType = pmesh.get_roundness_type();
 	}
+
+	// SubdivisionMeshとして出力する場合は、凹の多角形も分割しない.
+	m_pPolygonMeshCtrl->SetTriangulateNonConvex(m_dlgData.doSubdivision || m_currentSubdivisionType == 0);
+	// ローカル座標で出力する場合は、頂点を変換せずにConcatTransformで配置する.
+	if (!m_isLocalSpaceMesh) m_pPolygonMeshCtrl->SetTransform(lwMat);
+}
+
+/**
+ * ObjectBeginで定義済みの形状の場合は、ObjectInstanceを出力.
+ */
+bool CSaveRIB::WritePolygonMeshInstance (sxsdk::shape_class* shape, const sxsdk::mat4& lwMat)
+{
+	std::map<sxsdk::shape_class*, std::vector<CObjectInstancePart> >::const_iterator iter = m_objectInstances.find(shape);
+	if (iter == m_objectInstances.end()) return false;
+
+	m_WriteObjectInstance(shape, iter->second, lwMat);
+	return true;
+}
+
+/**
+ * 定義済みのオブジェクトを参照するObjectInstanceを、faceGroupごとにマテリアルを割り当てて出力.
+ * マテリアルは定義した形状(リンク元)の表面材質を使用する.
+ * カメラの視野外に配置される場合は出力しない.
+ */
+void CSaveRIB::m_WriteObjectInstance (sxsdk::shape_class* shape, const std::vector<CObjectInstancePart>& parts, const sxsdk::mat4& lwMat)
+{
+	if (m_viewFrustum.IsEnabled() && !parts.empty() && parts[0].hasBoundingBox) {
+		if (!m_viewFrustum.IsVisible(parts[0].bbMin, parts[0].bbMax, lwMat)) {
+			m_culledShapesCount++;
+			return;
+		}
+	}
+
+	for (size_t i = 0; i < parts.size(); ++i) {
+		const CObjectInstancePart& part = parts[i];
+		if (part.masterSurface) {
+			m_BeginWriteMaterial(m_pScene, *part.masterSurface);
+		} else {
+			m_BeginWriteMaterial(m_pScene, *shape);
+		}
+		m_indent++;
+
+		m_writer.BeginLine(m_indent);
+		m_writer.WriteRequest("Attribute");
+		m_writer.WriteString("identifier", true);
+		m_writer.WriteString("name", true);
+		m_writer.WriteStringArray(std::vector<std::string>(1, part.name));
+		m_writer.EndLine();
+
+		m_WriteConcatTransform(lwMat);
+
+		m_writer.BeginLine(m_indent);
+		m_writer.WriteRequest("ObjectInstance");
+		m_writer.WriteString(part.handle);
+		m_writer.EndLine();
+
+		m_indent--;
+		m_EndWriteMaterial();
+	}
+}
+
+/**
+ * 変換行列をConcatTransformとして出力.
+ * 形状はZを反転して出力しているため、Z反転行列Sで S * m * S に変換する.
+ */
+void CSaveRIB::m_WriteConcatTransform (const sxsdk::mat4& m)
+{
+	const float s[4] = { 1.0f, 1.0f, -1.0f, 1.0f };
+	float values[16];
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) values[i * 4 + j] = m[i][j] * s[i] * s[j];
+	}
+
+	m_writer.BeginLine(m_indent);
+	m_writer.WriteRequest("ConcatTransform");
+	m_writer.WriteFloatArray(values, 16);
+	m_writer.EndLine();
 }
 
 /**
  * ポリゴンメッシュ情報の格納終了.
+ * faceGroupごとの頂点の分離と形状情報の出力はCMeshOutputJobで行い、
+ * スレッドプールがある場合はワーカースレッドで実行する (出力順は保持される).
+ * インスタンスとして出力する場合は、ObjectBegin/ObjectEndで定義してからObjectInstanceで参照する.
  */
 void CSaveRIB::EndPolygonMesh ()
 {
-	m_polygonMeshCtrl.EndStore();
-	if (!m_pCurrentShape) return;
-
-	// faceGroupにより分割されている情報リストを取得.
+	std::shared_ptr<CPolygonMeshCtrl> meshCtrl = m_pPolygonMeshCtrl;
+	m_pPolygonMeshCtrl.reset();
+	if (!meshCtrl || !m_pCurrentShape) return;
+
+	// Shade3Dからの頂点/面情報の格納時間と、メインスレッドでの出力時間を計測.
+	const std::string shapeName = Util::ReplaceName(std::string(m_pCurrentShape->get_name()));
+	// 同じ名前の形状があるため、形状ごとの集計はBeginPolygonMeshで割り当てた通し番号で行う.
+	if (m_pProfiler) m_pProfiler->AddEvent(shapeName, "store", m_meshStoreStartTime, m_pProfiler->GetTime() - m_meshStoreStartTime, NULL, m_meshShapeID);
+	CExportProfiler::CScope scope(m_pProfiler, shapeName, "shape", m_meshShapeID);
+
+	// カメラの視野外の形状は、面の分類や出力を行わずに除外する.
+	// 格納した頂点は変換前のローカル座標のため、バウンディングボックスをm_meshLWMatrixで変換して判定する.
+	// インスタンスは、他の位置に配置されるObjectInstanceから参照されるためObjectBeginの定義は除外しない.
+	// 配置ごとのObjectInstanceは、保持したバウンディングボックスでm_WriteObjectInstanceが判定する.
+	sxsdk::vec3 bbMin(0, 0, 0), bbMax(0, 0, 0);
+	const bool hasBoundingBox = m_viewFrustum.IsEnabled() && meshCtrl->GetStoredBoundingBox(bbMin, bbMax);
+	if (hasBoundingBox && !m_isInstanceMesh && !m_viewFrustum.IsVisible(bbMin, bbMax, m_meshLWMatrix)) {
+		m_culledShapesCount++;
+		return;
+	}
+
+	// faceGroupにより分割される情報リストを取得.
 	std::vector<int> faceGroupIndexList;
-	m_polygonMeshCtrl.GetFaceGroupIndexList(faceGroupIndexList);
+	meshCtrl->BuildFaceGroups();
+	meshCtrl->GetStoredFaceGroupIndexList(faceGroupIndexList);
 	const int meshCou = faceGroupIndexList.size();
 	if (meshCou == 0) return;
 
@@ -2546,150 +2867,217 @@ void CSaveRIB::EndPolygonMesh ()
 		pmesh = &(m_pCurrentShape->get_polygon_mesh());
 	}
 
-	for (int loop = 0; loop < meshCou; loop++) {
-		const int polygonsCou = m_polygonMeshCtrl.GetPolygonsCount(loop);
+	// プールのメッシュ情報の場合は、参照する出力処理を登録して完了するまで再利用しない.
+	CPolygonMeshPoolEntry* poolEntry = NULL;
+	for (size_t i = 0; i < m_polygonMeshCtrlPool.size() && !poolEntry; ++i) {
+		if (m_polygonMeshCtrlPool[i].meshCtrl == meshCtrl) poolEntry = &m_polygonMeshCtrlPool[i];
+	}
+
+	CMeshOutputParam param;
+	param.encoding        = m_dlgData.ribEncoding;
+	param.subdivisionMesh = (!m_dlgData.doSubdivision && m_currentSubdivisionType > 0);
+	param.outputNormals   = (m_dlgData.doSubdivision || m_currentSubdivisionType == 0);
+	param.archive         = m_dlgData.geometryArchive;
+	param.compress        = m_dlgData.ribCompress;
+	param.archivePath     = m_RIBInfo.filePath;
+	param.cache           = &m_geometryCache;
+	param.reuseCache      = m_dlgData.geometryCache;
+	param.pointPrecision  = CRIBFloatPrecision(m_dlgData.precisionP, 0, m_dlgData.quantizeGrid);
+	param.normalPrecision = CRIBFloatPrecision(0, m_dlgData.precisionN);
+	param.uvPrecision     = CRIBFloatPrecision(0, m_dlgData.precisionST);
+	param.lod             = m_lodParam;
+	param.name            = shapeName;
+	param.shapeID         = m_meshShapeID;
+	param.profiler        = m_pProfiler;
+	param.scratchPool     = m_dlgData.streamingOutput ? NULL : &m_meshScratchPool;
+
+	// ローカル座標で出力する場合、簡略化ではカメラ位置をローカル座標に変換して距離を求める.
+	// 頂点座標が変換行列に依存しないため、変換のみを変更した場合も形状アーカイブのキャッシュを再利用できる.
+	if (m_isLocalSpaceMesh && !m_isInstanceMesh && param.lod.IsEnabled()) {
+		sxsdk::mat4 wlMat;
+		if (MathUtil::InverseMatrix(m_meshLWMatrix, wlMat)) {
+			param.lod.cameraPosition = param.lod.cameraPosition * wlMat;
+		} else {
+			param.lod = CMeshLODParam();
+		}
+	}
 
-		std::vector<sxsdk::vec3> vertices;
-		std::vector<sxsdk::vec3> normals;
-		std::vector<sxsdk::vec2> uvs;
-		m_polygonMeshCtrl.GetOutputVertices(loop, vertices);
-		m_polygonMeshCtrl.GetOutputNormals(loop, normals);
-		m_polygonMeshCtrl.GetOutputUVs(loop, uvs);
+	// ObjectBegin内ではDelayedReadArchiveを使用できないため、形状情報は直接出力する.
+	// インスタンスはローカル座標で格納し、複数の位置に配置されるため簡略化しない.
+	// マテリアル(Bxdf/Pattern/Attribute)はObjectBegin内に含めず、ObjectInstanceを出力する側で割り当てる.
+	// faceGroupごとにマテリアルが異なるため、faceGroupごとに別のオブジェクトとして定義する.
+	std::vector<CObjectInstancePart> instanceParts;
+	if (m_isInstanceMesh) {
+		param.archive = false;
+		param.lod     = CMeshLODParam();
+	}
 
-		const int verCou = vertices.size();
+	for (int loop = 0; loop < meshCou; loop++) {
+		std::string name = Util::ReplaceName(std::string(m_pCurrentShape->get_name()));
+		if (loop > 0) {
+			std::stringstream s;
+			s << name << "_" << loop;
+			name = s.str();
+		}
+
+		if (m_isInstanceMesh) {
+			CObjectInstancePart part;
+			part.name   = name;
+			part.handle = name;
+			for (int cou = 2; m_objectInstanceNames.find(part.handle) != m_objectInstanceNames.end(); ++cou) {
+				std::stringstream s;
+				s << name << "_" << cou;
+				part.handle = s.str();
+			}
+			if (faceGroupIndexList[loop] >= 0 && pmesh) part.masterSurface = pmesh->get_face_group_surface(faceGroupIndexList[loop]);
+			part.hasBoundingBox = hasBoundingBox;
+			part.bbMin          = bbMin;
+			part.bbMax          = bbMax;
+			m_objectInstanceNames.insert(part.handle);
+			instanceParts.push_back(part);
+
+			m_writer.BeginLine(m_indent);
+			m_writer.WriteRequest("ObjectBegin");
+			m_writer.WriteString(part.handle);
+			m_writer.EndLine();
+			m_indent++;
 
-		// マテリアルの割り当て開始.
-		if (faceGroupIndexList[loop] < 0) {
-			m_BeginWriteMaterial(m_pScene, *m_pCurrentShape);
 		} else {
-			if (pmesh) {
-				sxsdk::master_surface_class* masterSurface = pmesh->get_face_group_surface(faceGroupIndexList[loop]);
-				if (masterSurface) {
-					m_BeginWriteMaterial(m_pScene, *masterSurface);
-				} else {
-					m_BeginWriteMaterial(m_pScene, *m_pCurrentShape);
+			// マテリアルの割り当て開始.
+			if (faceGroupIndexList[loop] < 0) {
+				m_BeginWriteMaterial(m_pScene, *m_pCurrentShape);
+			} else {
+				if (pmesh) {
+					sxsdk::master_surface_class* masterSurface = pmesh->get_face_group_surface(faceGroupIndexList[loop]);
+					if (masterSurface) {
+						m_BeginWriteMaterial(m_pScene, *masterSurface);
+					} else {
+						m_BeginWriteMaterial(m_pScene, *m_pCurrentShape);
+					}
 				}
 			}
-		}
 
-		{
-			std::stringstream s;
-			s << "TransformBegin";
-			m_WriteLine(s.str());
-		}
-		m_indent++;
+			m_writer.BeginLine(m_indent);
+			m_writer.WriteRequest("TransformBegin");
+			m_writer.EndLine();
+			m_indent++;
 
-		{
-			std::stringstream s;
-			const std::string name = Util::ReplaceName(std::string(m_pCurrentShape->get_name()));
-			if (loop == 0) {
-				s << "Attribute \"identifier\" \"name\" [\"" << name << "\"]";
-			} else {
-				s << "Attribute \"identifier\" \"name\" [\"" << name << "_" << loop << "\"]";
-			}
-			m_WriteLine(s.str());
-		}
+			m_writer.BeginLine(m_indent);
+			m_writer.WriteRequest("Attribute");
+			m_writer.WriteString("identifier", true);
+			m_writer.WriteString("name", true);
+			m_writer.WriteStringArray(std::vector<std::string>(1, name));
+			m_writer.EndLine();
 
-		if (!m_dlgData.doSubdivision && m_currentSubdivisionType > 0) {
-			// catmull-clark での滑らかな曲線.
-			m_WriteLine("SubdivisionMesh \"catmull-clark\"");
-		} else {
-			m_WriteLine("PointsPolygons");
+			// ローカル座標で格納した形状は、ConcatTransformで配置する.
+			if (m_isLocalSpaceMesh) m_WriteConcatTransform(m_meshLWMatrix);
 		}
-		m_indent++;
 
-		// 面の頂点数を格納.
-		std::vector<int> faceVersCountList;
-		m_polygonMeshCtrl.GetPolygonsVCount(loop, faceVersCountList);
+		// 形状情報の出力.
+		// アーカイブファイルに出力する場合は、同一名の形状がある場合に連番を付けてファイル名を重複させない.
+		// Windows/macOSのファイルシステムは大文字/小文字を区別しないため、小文字にした名前で判定する.
+		param.indent = m_indent;
+		if (param.archive) {
+			m_CreateGeometryFolder();
 
-		{
-			std::stringstream s;
-			s << "[ ";
-			for (int i = 0; i < polygonsCou; i++) {
-				s << faceVersCountList[i] << " ";
+			std::string archiveName = name;
+			for (int cou = 2; m_geometryArchiveNames.find(Util::ToLower(archiveName)) != m_geometryArchiveNames.end(); ++cou) {
+				std::stringstream s;
+				s << name << "_" << cou;
+				archiveName = s.str();
 			}
-			s << "]";
-			m_WriteLine(s.str());
+			m_geometryArchiveNames.insert(Util::ToLower(archiveName));
+			param.archiveFileName = "geometry/" + archiveName + (m_dlgData.ribCompress ? ".rib.gz" : ".rib");
 		}
-
-		// 面のインデックスリストの格納.
 		{
-			std::stringstream s;
-			s << "[ ";
-
-			std::vector<int> indices;
-			for (int i = 0; i < polygonsCou; i++) {
-				m_polygonMeshCtrl.GetPolygonIndices(loop, i, indices);
-				const int vCou = faceVersCountList[i];
-				for (int j = 0; j < vCou; ++j) {
-					s << indices[vCou - j - 1]  << " ";		// 座標系が逆向きになるため、頂点の並びも逆にする.
+			std::shared_ptr<CMeshOutputJob> job(new CMeshOutputJob(meshCtrl, faceGroupIndexList[loop], param));
+			if (m_dlgData.streamingOutput) {
+				// 出力内容をメモリ上に保持せず、分割して直接書き出す.
+				// 最後のfaceGroupでは、頂点の分離後に格納したメッシュ情報を解放させる.
+				if (loop + 1 == meshCou) meshCtrl.reset();
+				if (!job->Write(m_writer)) m_ReportOutputError(job->GetError());
+			} else {
+				if (poolEntry) poolEntry->jobs.push_back(job);
+				if (m_pThreadPool) {
+					m_pThreadPool->Push(std::bind(&CMeshOutputJob::Run, job));
+				} else {
+					job->Run();
 				}
-				s << " ";
+				m_writer.AppendDeferred(job);
 			}
-			s << "]";
-			m_WriteLine(s.str());
 		}
 
-		if (!m_dlgData.doSubdivision && m_currentSubdivisionType > 0) {
-			// catmull-clark 時に、エッジはSubdivisionせずに保持.
-			m_WriteLine("[\"interpolateboundary\"] [0 0] [] []");
-		}
+		m_indent--;
+		if (m_isInstanceMesh) {
+			m_writer.BeginLine(m_indent);
+			m_writer.WriteRequest("ObjectEnd");
+			m_writer.EndLine();
 
-		// 頂点座標の格納.
-		{
-			std::stringstream s;
-			s << "\"P\" [ ";
-			for (int i = 0; i < verCou; i++) {
-				s << vertices[i].x << " " << vertices[i].y << " " << -vertices[i].z << " ";
-			}
-			s << "]";
-			m_WriteLine(s.str());
-		}
+		} else {
+			m_writer.BeginLine(m_indent);
+			m_writer.WriteRequest("TransformEnd");
+			m_writer.EndLine();
 
-		// 法線の格納.
-		if (m_dlgData.doSubdivision || m_currentSubdivisionType == 0) {
-			std::stringstream s;
-			s << "\"N\" [ ";
-			for (int i = 0; i < verCou; i++) {
-				s << normals[i].x << " " << normals[i].y << " " << -normals[i].z << " ";
-			}
-			s << "]";
-			m_WriteLine(s.str());
+			// マテリアルの割り当て終了.
+			m_EndWriteMaterial();
 		}
+	}
 
-		// UVの格納.
-		{
-			std::stringstream s;
-			s << "\"st\" [ ";
-			for (int i = 0; i < verCou; i++) {
-				s << uvs[i].x << " " << uvs[i].y << " ";
-			}
-			s << "]";
-			m_WriteLine(s.str());
-		}
+	if (m_isInstanceMesh) {
+		m_objectInstances[m_pCurrentShape] = instanceParts;
+		m_WriteObjectInstance(m_pCurrentShape, instanceParts, m_meshLWMatrix);
+	}
 
-		m_indent--;
+	// 処理済みの出力を書き出す。処理待ちが多い場合はメモリ使用量を抑えるため待つ.
+	m_writer.CommitDeferred(m_pThreadPool ? m_pThreadPool->GetThreadCount() * 4 : 0);
+	m_ReportDeferredErrors();
 
-		m_indent--;
-		m_WriteLine("TransformEnd");
+	// 出力が終わった大きな形状の格納領域は、次の形状を待たずに解放する.
+	meshCtrl.reset();
+	m_TrimPolygonMeshCtrlPool();
+}
 
-		// マテリアルの割り当て終了.
-		m_EndWriteMaterial();
+/**
+ * geometryフォルダがない場合は作成.
+ */
+void CSaveRIB::m_CreateGeometryFolder ()
+{
+	struct stat buffer;
+	const std::string geometryPath = m_RIBInfo.filePath + "/geometry";
+	if (stat(geometryPath.c_str(), &buffer) != 0) {
+#if SXWINDOWS
+		_mkdir(geometryPath.c_str());
+#else
+		mkdir(geometryPath.c_str(), S_IRWXU);
+#endif
 	}
 }
 
+/**
+ * 頂点数/面数を指定して、格納領域を確保.
+ */
+void CSaveRIB::ReservePolygonMeshVertex (const int count)
+{
+	if (m_pPolygonMeshCtrl) m_pPolygonMeshCtrl->ReserveVertices(count);
+}
+
+void CSaveRIB::ReservePolygonMeshPolygon (const int count)
+{
+	if (m_pPolygonMeshCtrl) m_pPolygonMeshCtrl->ReservePolygons(count);
+}
+
 /**
  * 頂点座標追加.
  */
 void CSaveRIB::AppendPolygonMeshVertex (const sxsdk::vec3& v)
 {
-	m_polygonMeshCtrl.AppendVertex(v);
+	if (m_pPolygonMeshCtrl) m_pPolygonMeshCtrl->AppendVertex(v);
 }
 
 /**
  * 面情報追加.
  */
-void CSaveRIB::AppendPolygonMeshPolygon (const std::vector<int>& indices, const std::vector<sxsdk::vec3>& normals, const std::vector<sxsdk::vec2>& uvs, const int faceGroupIndex)
+void CSaveRIB::AppendPolygonMeshPolygon (const int count, const int* indices, const sxsdk::vec3* normals, const sxsdk::vec2* uvs, const int uvStride, const int faceGroupIndex)
 {
-	m_polygonMeshCtrl.AppendPolygon(indices, normals, uvs, faceGroupIndex);
+	if (m_pPolygonMeshCtrl) m_pPolygonMeshCtrl->AppendPolygon(count, indices, normals, uvs, uvStride, faceGroupIndex);
 }
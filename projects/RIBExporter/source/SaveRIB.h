@@ -10,6 +10,15 @@
 #include "MaterialCtrl.h"
 #include "PolygonMeshCtrl.h"
 #include "LightCtrl.h"
+#include "RIBWriter.h"
+#include "GeometryCache.h"
+#include "MeshOutput.h"
+#include "ThreadPool.h"
+#include "ExportProfiler.h"
+#include "ViewFrustum.h"
+
+#include <set>
+#include <map>
 
 //-----------------------------------------------------------.
 // 保存するRIBファイルの情報.
@@ -62,6 +71,55 @@ public:
 	void Clear ();
 };
 
+//-----------------------------------------------------------.
+// ObjectBeginで定義したインスタンスのfaceGroupごとの情報.
+// マテリアルはObjectBegin内では割り当てられないため、ObjectInstanceを出力する側で割り当てる.
+//-----------------------------------------------------------.
+class CObjectInstancePart
+{
+public:
+	std::string handle;								// ObjectBeginのハンドル名.
+	std::string name;								// Attribute "identifier" で指定する名前.
+	sxsdk::master_surface_class* masterSurface;		// faceGroupのマスターサーフェス (NULLの場合は形状の表面材質).
+	bool hasBoundingBox;							// 視野外の配置を除外するためのバウンディングボックスを保持している場合はtrue.
+	sxsdk::vec3 bbMin, bbMax;						// 形状(リンク元)全体のローカル座標でのバウンディングボックス.
+
+public:
+	CObjectInstancePart () {
+		masterSurface  = NULL;
+		hasBoundingBox = false;
+		bbMin          = sxsdk::vec3(0, 0, 0);
+		bbMax          = sxsdk::vec3(0, 0, 0);
+	}
+};
+
+//-----------------------------------------------------------.
+// 再利用するポリゴンメッシュ情報と、それを参照する出力処理.
+// 出力処理のスレッドがメッシュ情報を読み終えたかは、参照カウントではなく出力処理の完了(IsDone)で判定する.
+//-----------------------------------------------------------.
+class CPolygonMeshPoolEntry
+{
+public:
+	std::shared_ptr<CPolygonMeshCtrl> meshCtrl;					// ポリゴンメッシュ情報.
+	std::vector< std::shared_ptr<CMeshOutputJob> > jobs;		// meshCtrlを参照する、完了を確認していない出力処理.
+
+public:
+	/**
+	 * 完了した出力処理をリストから除き、すべて完了している場合はtrueを返す.
+	 * IsDoneはジョブのmutexを介して読むため、ワーカースレッドでのメッシュ情報の参照はこの判定より前に終わっている.
+	 */
+	bool IsFree () {
+		size_t dst = 0;
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			if (jobs[i]->IsDone()) continue;
+			if (dst != i) jobs[dst] = jobs[i];
+			dst++;
+		}
+		jobs.resize(dst);
+		return jobs.empty();
+	}
+};
+
 //-----------------------------------------------------------.
 // RIB出力クラス.
 //-----------------------------------------------------------.
@@ -72,7 +130,11 @@ private:
 	sxsdk::text_stream_interface* m_text_stream;
 	sxsdk::stream_interface* m_stream;
 
-	CPolygonMeshCtrl m_polygonMeshCtrl;			// ポリゴンメッシュ情報を一時格納用.
+	CRIBWriter m_writer;						// RIBの出力クラス (ASCII/バイナリ、gzip圧縮).
+	std::shared_ptr<CPolygonMeshCtrl> m_pPolygonMeshCtrl;	// ポリゴンメッシュ情報を一時格納用 (出力処理に引き渡す).
+	std::vector<CPolygonMeshPoolEntry> m_polygonMeshCtrlPool;	// 再利用するポリゴンメッシュ情報 (参照する出力処理がすべて完了したものを使用).
+	CMeshScratchPool m_meshScratchPool;						// 形状の出力処理で使用する作業領域.
+	CThreadPool* m_pThreadPool;					// 形状の出力処理を行うスレッドプール.
 	CLightCtrl m_lightCtrl;						// 光源の一時格納クラス.
 
 	CRIBInfo m_RIBInfo;							// RIB情報.
@@ -89,6 +151,26 @@ private:
 
 	int m_currentSubdivisionType;				// ポリゴンメッシュのSubdivisionの種類 (sxsdk::polygon_mesh_classs::get_roundness_type() の値).
 
+	std::set<std::string> m_geometryArchiveNames;	// 出力済みの形状アーカイブ名 (小文字に変換した名前).
+	CGeometryArchiveCache m_geometryCache;			// 形状アーカイブのキャッシュ情報.
+
+	bool m_isInstanceMesh;										// 格納中のポリゴンメッシュをインスタンスとして出力する場合はtrue.
+	bool m_isLocalSpaceMesh;									// 格納中のポリゴンメッシュをローカル座標で格納する場合はtrue (インスタンスもしくはlocalSpaceGeometry).
+	sxsdk::mat4 m_meshLWMatrix;									// 格納中のポリゴンメッシュのローカル→ワールド変換行列.
+	std::map<sxsdk::shape_class*, std::vector<CObjectInstancePart> > m_objectInstances;	// ObjectBeginで定義済みの形状と、faceGroupごとの定義.
+	std::set<std::string> m_objectInstanceNames;				// 使用済みのハンドル名.
+
+	CMeshLODParam m_lodParam;					// 遠くの形状の簡略化のパラメータ.
+	CViewFrustum m_viewFrustum;					// カメラの視野外の形状を除外する場合の視錐台.
+	int m_culledShapesCount;					// 視野外のため出力しなかった形状数.
+	bool m_outputFailed;						// 出力できなかった形状がある場合はtrue.
+
+	CExportProfiler m_profiler;					// エクスポート処理の計測.
+	CExportProfiler* m_pProfiler;				// 計測する場合は&m_profiler、しない場合はNULL.
+	long long m_traverseStartTime;				// 形状の走査の開始時間.
+	long long m_meshStoreStartTime;				// ポリゴンメッシュ情報の格納の開始時間.
+	int m_meshShapeID;							// 格納中のポリゴンメッシュの通し番号 (計測結果を形状ごとに集計する).
+
 	/**
 	 * ヘッダの出力.
 	 */
@@ -105,20 +187,35 @@ private:
 	void m_WriteTextures ();
 
 	/**
-	 * インデントからスペースを取得.
+	 * 1行分の出力.
 	 */
-	std::string m_IndentToText(const int indent);
+	void m_WriteLine(const std::string& str);
 
 	/**
-	 * 1行分の出力.
+	 * 計測結果を表示し、指定されている場合はファイルに保存.
 	 */
-	void m_WriteLine(const std::string& str);
+	void m_OutputProfile ();
+
+	/**
+	 * gzip圧縮したRIBファイル(.rib.gz)に出力先を切り替える.
+	 */
+	void m_OpenCompressedRIB ();
 
 	/**
 	 * 位置情報を出力.
 	 */
 	void m_WriteMatrix(const sxsdk::mat4& m, const bool outScale = true);
 
+	/**
+	 * 変換行列をConcatTransformとして出力 (右手系から左手系に変換).
+	 */
+	void m_WriteConcatTransform (const sxsdk::mat4& m);
+
+	/**
+	 * 定義済みのオブジェクトを参照するObjectInstanceを、faceGroupごとにマテリアルを割り当てて出力.
+	 */
+	void m_WriteObjectInstance (sxsdk::shape_class* shape, const std::vector<CObjectInstancePart>& parts, const sxsdk::mat4& lwMat);
+
 	/**
 	 * 光源の出力.
 	 */
@@ -152,6 +249,31 @@ private:
 	 */
 	void m_EndWriteMaterial ();
 
+	/**
+	 * geometryフォルダがない場合は作成.
+	 */
+	void m_CreateGeometryFolder ();
+
+	/**
+	 * 参照する出力処理がすべて完了したポリゴンメッシュ情報を取得 (ない場合は作成).
+	 */
+	std::shared_ptr<CPolygonMeshCtrl> m_AcquirePolygonMeshCtrl ();
+
+	/**
+	 * プール内の出力処理が終わったポリゴンメッシュ情報のうち、確保済みの領域が上限を超えるものを解放.
+	 */
+	void m_TrimPolygonMeshCtrlPool ();
+
+	/**
+	 * 形状の出力処理でのエラーを表示し、エクスポートを失敗とする.
+	 */
+	void m_ReportOutputError (const std::string& error);
+
+	/**
+	 * 書き出した確定待ちの出力のうち、作成に失敗したもののエラーを表示.
+	 */
+	void m_ReportDeferredErrors ();
+
 	/**
 	 * テクスチャ番号に対応するテクスチャ名を取得.
 	 */
@@ -221,6 +343,7 @@ private:
 
 public:
 	CSaveRIB (sxsdk::shade_interface& shade, sxsdk::stream_interface* stream, sxsdk::text_stream_interface* text_stream, const RIBExportData& dlgData);
+	~CSaveRIB ();
 
 	/**
 	 * 出力したribファイル名を取得.
@@ -239,19 +362,36 @@ public:
 
 	/**
 	 * エクスポート終了.
+	 * @return 出力できなかった形状がある場合はfalse (内容はメッセージに表示済み).
 	 */
-	void EndExport ();
+	bool EndExport ();
 
 	/**
 	 * ポリゴンメッシュ情報の格納開始.
+	 * 頂点/法線はローカル座標で渡し、格納後にlwMatでまとめて変換する.
+	 * @param[in] shape     形状.
+	 * @param[in] lwMat     ローカル→ワールド変換行列.
+	 * @param[in] instance  インスタンスとして出力する場合はtrue (頂点はローカル座標のまま格納し、lwMatはObjectInstanceの配置に使用する).
+	 */
+	void BeginPolygonMesh (sxsdk::shape_class* shape, const sxsdk::mat4& lwMat, const bool instance = false);
+
+	/**
+	 * ObjectBeginで定義済みの形状の場合は、ObjectInstanceを出力.
+	 * @return 定義済みでない場合はfalse (BeginPolygonMeshで格納して定義する).
 	 */
-	void BeginPolygonMesh (sxsdk::shape_class* shape);
+	bool WritePolygonMeshInstance (sxsdk::shape_class* shape, const sxsdk::mat4& lwMat);
 
 	/**
 	 * ポリゴンメッシュ情報の格納終了.
 	 */
 	void EndPolygonMesh ();
 
+	/**
+	 * 頂点数/面数を指定して、格納領域を確保.
+	 */
+	void ReservePolygonMeshVertex (const int count);
+	void ReservePolygonMeshPolygon (const int count);
+
 	/**
 	 * 頂点座標追加.
 	 */
@@ -259,8 +399,10 @@ public:
 
 	/**
 	 * 面情報追加.
+	 * @param[in] uvs       UV (NULLの場合は(0, 0)).
+	 * @param[in] uvStride  面の頂点ごとのUVの間隔.
 	 */
-	void AppendPolygonMeshPolygon (const std::vector<int>& indices, const std::vector<sxsdk::vec3>& normals, const std::vector<sxsdk::vec2>& uvs, const int faceGroupIndex = -1);
+	void AppendPolygonMeshPolygon (const int count, const int* indices, const sxsdk::vec3* normals, const sxsdk::vec2* uvs, const int uvStride, const int faceGroupIndex = -1);
 };
 
 #endif
@@ -4,13 +4,27 @@
  */
 
 #include "ShapeStack.h"
+#include "MathUtil.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
+namespace {
+	/**
+	 * 2つの行列の要素がすべて一致するか.
+	 */
+	bool IsSameMatrix (const sxsdk::mat4& a, const sxsdk::mat4& b) {
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 4; ++j) {
+				if (a[i][j] != b[i][j]) return false;
+			}
+		}
+		return true;
+	}
+}
+
 CShapeStack::CShapeStack()
 {
-	m_LWMat = sxsdk::mat4::identity;
 	m_stackNode.clear();
 }
 
@@ -25,7 +39,6 @@ CShapeStack::~CShapeStack()
 void CShapeStack::Clear()
 {
 	m_stackNode.clear();
-	m_LWMat = sxsdk::mat4::identity;
 }
 
 /**
@@ -41,9 +54,10 @@ void CShapeStack::Push(const int depth, sxsdk::shape_class *pShape, sxsdk::mat4
 	node.depth       = depth;
 	node.pShape      = pShape;
 	node.tMat        = tMat;
+	node.lwMat       = m_stackNode.empty() ? tMat : (tMat * m_stackNode.back().lwMat);
+	node.wlValid      = false;
+	node.shapeLWValid = false;
 	m_stackNode.push_back(node);
-
-	m_LWMat = tMat * m_LWMat;
 }
 
 /**
@@ -51,20 +65,48 @@ void CShapeStack::Push(const int depth, sxsdk::shape_class *pShape, sxsdk::mat4
  */
 void CShapeStack::Pop()
 {
-	SHAPE_STACK_NODE *pNode;
-
-	int size = (int)m_stackNode.size();
-	if (size <= 0) return;
-	pNode = &(m_stackNode[size - 1]);
-	const sxsdk::mat4 tMat = pNode->tMat;
+	if (m_stackNode.empty()) return;
 	m_stackNode.pop_back();
-	size--;
+}
+
+/**
+ * 現在の累積変換行列の逆行列を取得.
+ */
+sxsdk::mat4 CShapeStack::GetWorldToLocalMatrix ()
+{
+	if (m_stackNode.empty()) return sxsdk::mat4::identity;
 
-	if (size >= 1) {
-		m_LWMat = inv(tMat) * m_LWMat;
-	} else {
-		m_LWMat = sxsdk::mat4::identity;
+	SHAPE_STACK_NODE& node = m_stackNode.back();
+	if (!node.wlValid) {
+		MathUtil::InverseMatrix(node.lwMat, node.wlMat);
+		node.wlValid = true;
 	}
+	return node.wlMat;
+}
+
+/**
+ * カレント形状自身の変換行列を除いた累積変換行列を取得.
+ * lwMat = tMat * (親要素のlwMat) のため、tMatが形状自身の変換行列と一致する場合は親要素のlwMatをそのまま使用する.
+ * 一致しない場合のみ、形状の変換行列の逆行列を計算する.
+ */
+sxsdk::mat4 CShapeStack::GetShapeLocalToWorldMatrix ()
+{
+	if (m_stackNode.empty()) return sxsdk::mat4::identity;
+
+	const int index = (int)m_stackNode.size() - 1;
+	SHAPE_STACK_NODE& node = m_stackNode[index];
+	if (!node.shapeLWValid) {
+		const sxsdk::mat4 shapeMat = node.pShape->get_transformation();
+		if (IsSameMatrix(node.tMat, shapeMat)) {
+			node.shapeLWMat = (index > 0) ? m_stackNode[index - 1].lwMat : sxsdk::mat4::identity;
+		} else {
+			sxsdk::mat4 invMat;
+			MathUtil::InverseMatrix(shapeMat, invMat);
+			node.shapeLWMat = invMat * node.lwMat;
+		}
+		node.shapeLWValid = true;
+	}
+	return node.shapeLWMat;
 }
 
 /**
@@ -89,15 +131,16 @@ int CShapeStack::GetShape(sxsdk::shape_class **ppRetShape, sxsdk::mat4 *pRetMat,
 	return 1;
 }
 
+/**
+ * LW行列を取得.
+ * 要素ごとに保持している累積変換行列を返す.
+ */
 sxsdk::mat4 CShapeStack::CalcLocalToWorldMatrix (const bool use_last)
 {
-	sxsdk::mat4 m = sxsdk::mat4::identity;
-	int size = m_stackNode.size();
+	int size = (int)m_stackNode.size();
 	if (!use_last) size--;
-	for (int i = 0; i < size; ++i) {
-		m *= m_stackNode[i].tMat;
-	}
-	return m;
+	if (size <= 0) return sxsdk::mat4::identity;
+	return m_stackNode[size - 1].lwMat;
 }
 
 int CShapeStack::GetShapes (std::vector<sxsdk::shape_class *> &shapes)
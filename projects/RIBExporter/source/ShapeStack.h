@@ -12,18 +12,23 @@ typedef struct {
 	int depth;						///< 階層の深さ.
 	sxsdk::shape_class *pShape;		///< 形状へのポインタ.
 	sxsdk::mat4 tMat;				///< 形状の変換行列.
+	sxsdk::mat4 lwMat;				///< この要素までの累積変換行列.
+	sxsdk::mat4 wlMat;				///< lwMatの逆行列 (wlValidがtrueの場合のみ有効).
+	sxsdk::mat4 shapeLWMat;			///< 形状自身の変換を除いた累積変換行列 (shapeLWValidがtrueの場合のみ有効).
+	bool wlValid;					///< wlMatを計算済みの場合はtrue.
+	bool shapeLWValid;				///< shapeLWMatを計算済みの場合はtrue.
 } SHAPE_STACK_NODE;
 
 /**
  * 形状および変換行列のスタック管理クラス.
+ * 累積変換行列は要素ごとに保持するため、プッシュ/ポップで行列の再計算や逆行列計算は行わない.
+ * 逆行列は必要になった時点で一度だけ計算し、要素にキャッシュする.
  */
 class CShapeStack
 {
 private:
 	std::vector<SHAPE_STACK_NODE> m_stackNode;
 
-	sxsdk::mat4 m_LWMat;	///< ルートからの累積変換行列.
-
 public:
 	CShapeStack();
 	~CShapeStack();
@@ -54,8 +59,15 @@ public:
 	/**
 	 * 現在の変換行列を取得.
 	 */
-	sxsdk::mat4 GetLocalToWorldMatrix () { return m_LWMat; }
-	sxsdk::mat4 GetWorldToLocalMatrix () { return inv(m_LWMat); }
+	sxsdk::mat4 GetLocalToWorldMatrix () { return m_stackNode.empty() ? sxsdk::mat4::identity : m_stackNode.back().lwMat; }
+	sxsdk::mat4 GetWorldToLocalMatrix ();
+
+	/**
+	 * カレント形状自身の変換行列を除いた累積変換行列を取得.
+	 * inv(形状の変換行列) * 累積変換行列 を要素ごとに一度だけ求めて返す.
+	 * プッシュした変換行列が形状の変換行列と同じ場合は、逆行列を計算せずに親要素の累積変換行列を使用する.
+	 */
+	sxsdk::mat4 GetShapeLocalToWorldMatrix ();
 
 	/**
 	 * スタックの要素数の取得.
@@ -73,7 +85,8 @@ public:
 	inline SHAPE_STACK_NODE *GetLast () { return (&m_stackNode[0]) + ((int)m_stackNode.size() - 1); }
 
 	/**
-	 * LW行列を計算.
+	 * LW行列を取得.
+	 * @param[in] use_last  最後の要素の変換行列を含める場合はtrue.
 	 */
 	sxsdk::mat4 CalcLocalToWorldMatrix (const bool use_last);
 
@@ -69,6 +69,71 @@ void StreamCtrl::SaveRIBExportDlg (sxsdk::scene_interface* scene, const RIBExpor
 		// ver.1.1.0.5 -.
 		iDat = data.doDenoise ? 1 : 0;
 		stream->write_int(iDat);
+
+		// ver.1.1.0.6 -.
+		stream->write_int((int)data.ribEncoding);
+
+		// ver.1.1.0.7 -.
+		iDat = data.ribCompress ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.0.8 -.
+		iDat = data.geometryArchive ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.0.9 -.
+		iDat = data.geometryCache ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.0 -.
+		iDat = data.parallelOutput ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.1 -.
+		iDat = data.objectInstance ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.2 -.
+		stream->write_int(data.precisionP);
+		stream->write_int(data.precisionN);
+		stream->write_int(data.precisionST);
+		stream->write_float(data.quantizeGrid);
+
+		// ver.1.1.1.3 -.
+		iDat = data.streamingOutput ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.4 -.
+		iDat = data.profileExport ? 1 : 0;
+		stream->write_int(iDat);
+		iDat = data.profileTrace ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.5 -.
+		stream->write_float(data.weldTolerance);
+
+		// ver.1.1.1.6 -.
+		iDat = data.facevaryingPrimvars ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.7 -.
+		iDat = data.lodDecimation ? 1 : 0;
+		stream->write_int(iDat);
+		stream->write_float(data.lodPixelSize);
+
+		// ver.1.1.1.8 -.
+		iDat = data.ngonPassthrough ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.9 -.
+		iDat = data.localSpaceGeometry ? 1 : 0;
+		stream->write_int(iDat);
+
+		// ver.1.1.1.a -.
+		iDat = data.frustumCulling ? 1 : 0;
+		stream->write_int(iDat);
+		stream->write_float(data.cullMargin);
+		stream->write_float(data.cullKeepRadius);
 	} catch (...) { }
 }
 
@@ -145,6 +210,101 @@ RIBExportData StreamCtrl::LoadRIBExportDlg (sxsdk::scene_interface* scene)
 			data.doDenoise = iDat ? true : false;
 		}
 
+		// ver.1.1.0.6 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1106) {
+			stream->read_int((int &)data.ribEncoding);
+		}
+
+		// ver.1.1.0.7 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1107) {
+			stream->read_int(iDat);
+			data.ribCompress = iDat ? true : false;
+		}
+
+		// ver.1.1.0.8 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1108) {
+			stream->read_int(iDat);
+			data.geometryArchive = iDat ? true : false;
+		}
+
+		// ver.1.1.0.9 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1109) {
+			stream->read_int(iDat);
+			data.geometryCache = iDat ? true : false;
+		}
+
+		// ver.1.1.1.0 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1110) {
+			stream->read_int(iDat);
+			data.parallelOutput = iDat ? true : false;
+		}
+
+		// ver.1.1.1.1 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1111) {
+			stream->read_int(iDat);
+			data.objectInstance = iDat ? true : false;
+		}
+
+		// ver.1.1.1.2 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1112) {
+			stream->read_int(data.precisionP);
+			stream->read_int(data.precisionN);
+			stream->read_int(data.precisionST);
+			stream->read_float(data.quantizeGrid);
+		}
+
+		// ver.1.1.1.3 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1113) {
+			stream->read_int(iDat);
+			data.streamingOutput = iDat ? true : false;
+		}
+
+		// ver.1.1.1.4 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1114) {
+			stream->read_int(iDat);
+			data.profileExport = iDat ? true : false;
+			stream->read_int(iDat);
+			data.profileTrace = iDat ? true : false;
+		}
+
+		// ver.1.1.1.5 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1115) {
+			stream->read_float(data.weldTolerance);
+		}
+
+		// ver.1.1.1.6 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1116) {
+			stream->read_int(iDat);
+			data.facevaryingPrimvars = iDat ? true : false;
+		}
+
+		// ver.1.1.1.7 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1117) {
+			stream->read_int(iDat);
+			data.lodDecimation = iDat ? true : false;
+			stream->read_float(data.lodPixelSize);
+		}
+
+		// ver.1.1.1.8 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1118) {
+			stream->read_int(iDat);
+			data.ngonPassthrough = iDat ? true : false;
+		}
+
+		// ver.1.1.1.9 -.
+		if (version >= RIB_EXPORT_DLG_VERSION_1119) {
+			stream->read_int(iDat);
+			data.localSpaceGeometry = iDat ? true : false;
+		}
+
+		// ver.1.1.1.a -.
+		if (version >= RIB_EXPORT_DLG_VERSION_111a) {
+			stream->read_int(iDat);
+			data.frustumCulling = iDat ? true : false;
+			stream->read_float(data.cullMargin);
+			stream->read_float(data.cullKeepRadius);
+		}
+
 	} catch (...) { }
 
 	return data;
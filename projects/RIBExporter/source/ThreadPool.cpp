@@ -0,0 +1,62 @@
+﻿/**
+ * スレッドプール.
+ */
+
+#include "ThreadPool.h"
+
+CThreadPool::CThreadPool (const int threadCount)
+{
+	m_stop = false;
+	for (int i = 0; i < threadCount; ++i) {
+		m_threads.push_back(std::thread(&CThreadPool::m_Worker, this));
+	}
+}
+
+CThreadPool::~CThreadPool ()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+	for (size_t i = 0; i < m_threads.size(); ++i) m_threads[i].join();
+}
+
+/**
+ * ワーカースレッドの処理.
+ */
+void CThreadPool::m_Worker ()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_stop && m_tasks.empty()) m_condition.wait(lock);
+			if (m_tasks.empty()) return;
+			task = m_tasks.front();
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+/**
+ * 処理を追加.
+ */
+void CThreadPool::Push (const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(task);
+	}
+	m_condition.notify_one();
+}
+
+/**
+ * 使用できるハードウェアのスレッド数を取得.
+ */
+int CThreadPool::GetHardwareThreadCount ()
+{
+	const int cou = (int)std::thread::hardware_concurrency();
+	return (cou > 0) ? cou : 1;
+}
@@ -0,0 +1,57 @@
+﻿/**
+ * スレッドプール.
+ * 形状の出力処理など、Shade3DのSDKを呼ばない処理を複数スレッドで実行する.
+ */
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class CThreadPool
+{
+private:
+	std::vector<std::thread> m_threads;					// ワーカースレッド.
+	std::deque< std::function<void()> > m_tasks;		// 実行待ちの処理.
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stop;										// 終了要求.
+
+	/**
+	 * ワーカースレッドの処理.
+	 */
+	void m_Worker ();
+
+public:
+	/**
+	 * @param[in] threadCount  スレッド数.
+	 */
+	CThreadPool (const int threadCount);
+
+	/**
+	 * 実行待ちの処理をすべて実行してからスレッドを終了する.
+	 */
+	~CThreadPool ();
+
+	/**
+	 * 処理を追加.
+	 */
+	void Push (const std::function<void()>& task);
+
+	/**
+	 * スレッド数を取得.
+	 */
+	int GetThreadCount () const { return (int)m_threads.size(); }
+
+	/**
+	 * 使用できるハードウェアのスレッド数を取得.
+	 */
+	static int GetHardwareThreadCount ();
+};
+
+#endif
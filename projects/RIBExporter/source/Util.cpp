@@ -136,3 +136,15 @@ std::string Util::ReplaceName (const std::string& str)
 
 	return name2;
 }
+
+/**
+ * 英字を小文字に変換 (ASCIIのみ).
+ */
+std::string Util::ToLower (const std::string& str)
+{
+	std::string str2 = str;
+	for (size_t i = 0; i < str2.length(); ++i) {
+		if (str2[i] >= 'A' && str2[i] <= 'Z') str2[i] = (char)(str2[i] - 'A' + 'a');
+	}
+	return str2;
+}
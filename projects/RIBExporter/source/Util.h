@@ -37,6 +37,12 @@ namespace Util {
 	 * 形状名に、「;:- " '」が含まれる場合は、「_」に置き換え.
 	 */
 	std::string ReplaceName (const std::string& str);
+
+	/**
+	 * 英字を小文字に変換 (ASCIIのみ。マルチバイト文字はそのまま).
+	 * 大文字/小文字を区別しないファイルシステムで、ファイル名の重複を判定する際に使用.
+	 */
+	std::string ToLower (const std::string& str);
 }
 
 #endif
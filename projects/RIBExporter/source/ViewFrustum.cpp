@@ -0,0 +1,108 @@
+﻿/**
+ * カメラの視野による形状の除外 (視錐台カリング).
+ */
+
+#include "ViewFrustum.h"
+#include "MathUtil.h"
+
+#include <cmath>
+#include <algorithm>
+
+CViewFrustum::CViewFrustum ()
+{
+	Clear();
+}
+
+/**
+ * 情報のクリア (判定を行わない).
+ */
+void CViewFrustum::Clear ()
+{
+	m_enabled           = false;
+	m_worldToViewMatrix = sxsdk::mat4::identity;
+	m_cameraPosition    = sxsdk::vec3(0, 0, 0);
+	m_tanX              = 0.0f;
+	m_tanY              = 0.0f;
+	m_keepRadius        = 0.0f;
+}
+
+/**
+ * 透視投影のカメラ情報から視錐台を指定.
+ */
+bool CViewFrustum::Set (const sxsdk::mat4& worldToViewMatrix, const float fov, const sx::vec<int,2>& imageSize, const float marginPercent, const float keepRadius)
+{
+	Clear();
+
+	const float tanHalfFov = std::tan(fov * 0.5f * sx::pi / 180.0f);
+	if (imageSize.x <= 0 || imageSize.y <= 0 || !(tanHalfFov > 0.0f)) return false;
+
+	sxsdk::mat4 viewToWorldMatrix;
+	if (!MathUtil::InverseMatrix(worldToViewMatrix, viewToWorldMatrix)) return false;
+
+	// 短辺方向の視野角がfovとなる.
+	const float scale = 1.0f + std::max(0.0f, marginPercent) * 0.01f;
+	if (imageSize.x >= imageSize.y) {
+		m_tanY = tanHalfFov;
+		m_tanX = tanHalfFov * (float)imageSize.x / (float)imageSize.y;
+	} else {
+		m_tanX = tanHalfFov;
+		m_tanY = tanHalfFov * (float)imageSize.y / (float)imageSize.x;
+	}
+	m_tanX *= scale;
+	m_tanY *= scale;
+
+	m_worldToViewMatrix = worldToViewMatrix;
+	m_cameraPosition    = sxsdk::vec3(0, 0, 0) * viewToWorldMatrix;
+	m_keepRadius        = std::max(0.0f, keepRadius);
+	m_enabled           = true;
+	return true;
+}
+
+/**
+ * バウンディングボックスが視野内にあるか.
+ */
+bool CViewFrustum::IsVisible (const sxsdk::vec3& bbMin, const sxsdk::vec3& bbMax, const sxsdk::mat4& lwMat) const
+{
+	if (!m_enabled) return true;
+
+	// バウンディングボックスの8頂点をワールド座標に変換.
+	sxsdk::vec3 corners[8];
+	for (int i = 0; i < 8; ++i) {
+		const sxsdk::vec3 p((i & 1) ? bbMax.x : bbMin.x, (i & 2) ? bbMax.y : bbMin.y, (i & 4) ? bbMax.z : bbMin.z);
+		corners[i] = p * lwMat;
+	}
+
+	// カメラから一定距離内にある場合は、映り込みなどのために残す.
+	if (m_keepRadius > 0.0f) {
+		sxsdk::vec3 wMin = corners[0], wMax = corners[0];
+		for (int i = 1; i < 8; ++i) {
+			wMin.x = std::min(wMin.x, corners[i].x);
+			wMin.y = std::min(wMin.y, corners[i].y);
+			wMin.z = std::min(wMin.z, corners[i].z);
+			wMax.x = std::max(wMax.x, corners[i].x);
+			wMax.y = std::max(wMax.y, corners[i].y);
+			wMax.z = std::max(wMax.z, corners[i].z);
+		}
+		const float dx = std::max(std::max(wMin.x - m_cameraPosition.x, m_cameraPosition.x - wMax.x), 0.0f);
+		const float dy = std::max(std::max(wMin.y - m_cameraPosition.y, m_cameraPosition.y - wMax.y), 0.0f);
+		const float dz = std::max(std::max(wMin.z - m_cameraPosition.z, m_cameraPosition.z - wMax.z), 0.0f);
+		if (dx * dx + dy * dy + dz * dz <= m_keepRadius * m_keepRadius) return true;
+	}
+
+	// ビュー座標で、視錐台の各面(手前/左/右/下/上)の外側にすべての頂点があるか判定.
+	// 視線方向の奥行きd = -zに対して、|x| <= d * tanX、|y| <= d * tanY が視野内.
+	int outside[5] = {0, 0, 0, 0, 0};
+	for (int i = 0; i < 8; ++i) {
+		const sxsdk::vec3 v = corners[i] * m_worldToViewMatrix;
+		const float d = -v.z;
+		if (d < 0.0f) outside[0]++;
+		if (v.x < -d * m_tanX) outside[1]++;
+		if (v.x >  d * m_tanX) outside[2]++;
+		if (v.y < -d * m_tanY) outside[3]++;
+		if (v.y >  d * m_tanY) outside[4]++;
+	}
+	for (int i = 0; i < 5; ++i) {
+		if (outside[i] == 8) return false;
+	}
+	return true;
+}
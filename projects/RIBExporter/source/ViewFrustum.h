@@ -0,0 +1,60 @@
+﻿/**
+ * カメラの視野による形状の除外 (視錐台カリング).
+ * カメラの視野外にある形状を、ポリゴンメッシュの処理前に判定する.
+ */
+
+#ifndef _VIEWFRUSTUM_H
+#define _VIEWFRUSTUM_H
+
+#include "GlobalHeader.h"
+
+/**
+ * カメラの視錐台.
+ * ビュー座標系はカメラ位置が原点で、-Z方向が視線方向.
+ */
+class CViewFrustum
+{
+private:
+	bool m_enabled;						// 判定を行う場合はtrue.
+	sxsdk::mat4 m_worldToViewMatrix;	// ワールド→ビュー変換行列.
+	sxsdk::vec3 m_cameraPosition;		// ワールド座標でのカメラ位置.
+	float m_tanX, m_tanY;				// 余白を含めた、水平/垂直方向の視野の半角のtan.
+	float m_keepRadius;					// カメラからこの距離内の形状は視野外でも残す (0の場合は無効).
+
+public:
+	CViewFrustum ();
+
+	/**
+	 * 情報のクリア (判定を行わない).
+	 */
+	void Clear ();
+
+	/**
+	 * 透視投影のカメラ情報から視錐台を指定.
+	 * RenderManと同じく、fovは画像の短辺に対する視野角とする.
+	 * @param[in] worldToViewMatrix  ワールド→ビュー変換行列.
+	 * @param[in] fov                視野角 (度).
+	 * @param[in] imageSize          レンダリング画像サイズ.
+	 * @param[in] marginPercent      視野を広げる余白 (%).
+	 * @param[in] keepRadius         カメラからこの距離内の形状は視野外でも残す (0の場合は無効).
+	 * @return 視錐台を計算できない場合はfalse (判定を行わない).
+	 */
+	bool Set (const sxsdk::mat4& worldToViewMatrix, const float fov, const sx::vec<int,2>& imageSize, const float marginPercent, const float keepRadius);
+
+	/**
+	 * 判定を行うか.
+	 */
+	bool IsEnabled () const { return m_enabled; }
+
+	/**
+	 * バウンディングボックスが視野内にあるか.
+	 * 視錐台の面ごとに、8頂点すべてが外側にある場合のみ視野外とする (視野外の形状を残すことはあるが、視野内の形状を除外することはない).
+	 * @param[in] bbMin  ローカル座標でのバウンディングボックスの最小位置.
+	 * @param[in] bbMax  ローカル座標でのバウンディングボックスの最大位置.
+	 * @param[in] lwMat  ローカル→ワールド変換行列.
+	 * @return 視野内、もしくはカメラからkeepRadiusの距離内にある場合はtrue.
+	 */
+	bool IsVisible (const sxsdk::vec3& bbMin, const sxsdk::vec3& bbMax, const sxsdk::mat4& lwMat) const;
+};
+
+#endif